@@ -0,0 +1,709 @@
+/*
+ * JOOS is Copyright (C) 1997 Laurie Hendren & Michael I. Schwartzbach
+ *
+ * Reproduction of all or part of this software is permitted for
+ * educational or research use on condition that this copyright notice is
+ * included in any copy. This software comes with no warranty of any
+ * kind. In no event will the authors be liable for any damages resulting from
+ * use of this software.
+ *
+ * email: hendren@cs.mcgill.ca, mis@brics.dk
+ */
+
+/* Writes .class files directly, as an alternative to emit.c and Jasmin.
+ * The files use the class file version Jasmin writes by default, which
+ * predates StackMapTable attributes, so the verifier infers the frames.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+#include "error.h"
+#include "bytecode.h"
+#include "code.h"
+#include "emit.h"
+
+#define CLASSMAJOR 45
+#define CLASSMINOR 3
+
+#define ACC_PUBLIC       0x0001
+#define ACC_PROTECTED    0x0004
+#define ACC_STATIC       0x0008
+#define ACC_FINAL        0x0010
+#define ACC_SUPER        0x0020
+#define ACC_SYNCHRONIZED 0x0020
+#define ACC_ABSTRACT     0x0400
+
+#define CONSTANT_Utf8        1
+#define CONSTANT_Integer     3
+#define CONSTANT_Class       7
+#define CONSTANT_String      8
+#define CONSTANT_Fieldref    9
+#define CONSTANT_Methodref   10
+#define CONSTANT_NameAndType 12
+
+typedef struct BUFFER {
+   unsigned char *data;
+   int size;
+   int used;
+} BUFFER;
+
+BUFFER pool;  /* the constant pool of the current class */
+BUFFER body;  /* everything after the constant pool */
+
+void bytegrow(BUFFER *b, int n)
+{ unsigned char *d;
+  if (b->used+n > b->size) {
+     b->size = 2*b->size+n+256;
+     d = (unsigned char *)Malloc(b->size);
+     if (b->used>0) memcpy(d,b->data,b->used);
+     if (b->data!=NULL) free(b->data);
+     b->data = d;
+  }
+}
+
+void put1(BUFFER *b, int x)
+{ bytegrow(b,1);
+  b->data[b->used++] = x & 0xff;
+}
+
+void put2(BUFFER *b, int x)
+{ put1(b,x>>8);
+  put1(b,x);
+}
+
+void put4(BUFFER *b, int x)
+{ put2(b,x>>16);
+  put2(b,x);
+}
+
+void patch4(BUFFER *b, int at, int x)
+{ b->data[at] = (x>>24) & 0xff;
+  b->data[at+1] = (x>>16) & 0xff;
+  b->data[at+2] = (x>>8) & 0xff;
+  b->data[at+3] = x & 0xff;
+}
+
+
+/******  The constant pool.  Entries are shared through a hash table,
+ ******  so every constant is written once per class.  ******/
+
+#define PoolHashSize 317
+
+typedef struct CONSTANT {
+   int tag;
+   char *text;   /* for Utf8 */
+   int a, b;     /* value or indices of the parts */
+   int index;
+   struct CONSTANT *next;
+} CONSTANT;
+
+CONSTANT *pooltable[PoolHashSize];
+int poolcount;
+
+int poolhash(int tag, char *text, int a, int b)
+{ unsigned int h;
+  h = (unsigned)tag*31+(unsigned)a*17+(unsigned)b;
+  if (text!=NULL) {
+     while (*text) h = (h << 1) + (unsigned char)*text++;
+  }
+  return h % PoolHashSize;
+}
+
+int constant(int tag, char *text, int a, int b)
+{ CONSTANT *k;
+  int h,n;
+  h = poolhash(tag,text,a,b);
+  for (k=pooltable[h]; k!=NULL; k=k->next) {
+      if (k->tag==tag && k->a==a && k->b==b &&
+          (text==NULL || strcmp(k->text,text)==0)) return k->index;
+  }
+  k = NEWIN(IRarena,CONSTANT);
+  k->tag = tag;
+  k->text = text;
+  k->a = a;
+  k->b = b;
+  k->index = poolcount++;
+  k->next = pooltable[h];
+  pooltable[h] = k;
+  put1(&pool,tag);
+  switch (tag) {
+    case CONSTANT_Utf8:
+         n = strlen(text);
+         put2(&pool,n);
+         bytegrow(&pool,n);
+         memcpy(pool.data+pool.used,text,n);
+         pool.used += n;
+         break;
+    case CONSTANT_Integer:
+         put4(&pool,a);
+         break;
+    case CONSTANT_Class:
+    case CONSTANT_String:
+         put2(&pool,a);
+         break;
+    default:
+         put2(&pool,a);
+         put2(&pool,b);
+         break;
+  }
+  return k->index;
+}
+
+int utf8(char *s)
+{ return constant(CONSTANT_Utf8,s,0,0);
+}
+
+int classref(char *name)
+{ return constant(CONSTANT_Class,NULL,utf8(name),0);
+}
+
+char *bytesub(char *s, int from, int to)
+{ char *t;
+  t = (char *)Allocate(IRarena,to-from+1);
+  strncpy(t,s+from,to-from);
+  t[to-from] = '\0';
+  return t;
+}
+
+/* arg is owner/name followed by the descriptor, separated by a space for
+ * fields as in "A/f I", and directly for methods as in "A/m(I)V".
+ */
+int memberref(int tag, char *arg)
+{ int i,j,nametype;
+  char *desc;
+  for (i=0; arg[i]!=' ' && arg[i]!='('; i++);
+  for (j=i; arg[j]!='/'; j--);
+  desc = arg[i]==' ' ? arg+i+1 : arg+i;
+  nametype = constant(CONSTANT_NameAndType,NULL,
+                      utf8(bytesub(arg,j+1,i)),utf8(desc));
+  return constant(tag,NULL,classref(bytesub(arg,0,j)),nametype);
+}
+
+/* appends the character v as modified UTF-8 */
+int utf8char(char *t, int v)
+{ if (v>0 && v<0x80) {
+     t[0] = v;
+     return 1;
+  }
+  if (v<0x800) {
+     t[0] = 0xc0 | (v >> 6);
+     t[1] = 0x80 | (v & 0x3f);
+     return 2;
+  }
+  t[0] = 0xe0 | (v >> 12);
+  t[1] = 0x80 | ((v >> 6) & 0x3f);
+  t[2] = 0x80 | (v & 0x3f);
+  return 3;
+}
+
+/* reads the UTF-8 sequence starting at s into *v and returns its length,
+ * or 0 if s does not start one.
+ */
+int utf8decode(char *s, int *v)
+{ int i,n,c;
+  c = (unsigned char)s[0];
+  if (c>=0xc0 && c<0xe0) {
+     n = 2;
+     *v = c & 0x1f;
+  } else if (c>=0xe0 && c<0xf0) {
+     n = 3;
+     *v = c & 0x0f;
+  } else if (c>=0xf0 && c<0xf8) {
+     n = 4;
+     *v = c & 0x07;
+  } else {
+     return 0;
+  }
+  for (i=1; i<n; i++) {
+      c = (unsigned char)s[i];
+      if ((c & 0xc0)!=0x80) return 0;
+      *v = (*v << 6) | (c & 0x3f);
+  }
+  return n;
+}
+
+/* turns a string literal, with the escapes Jasmin understands, into the
+ * modified UTF-8 a class file stores.  Characters outside the basic plane
+ * become surrogate pairs.
+ */
+int stringref(char *s)
+{ char *t;
+  int i,n,v,d,u;
+  t = (char *)Allocate(IRarena,3*strlen(s)+1);
+  n = 0;
+  for (i=0; s[i]!='\0'; i++) {
+      v = (unsigned char)s[i];
+      if (v>=0x80 && (d = utf8decode(s+i,&u))>0) {
+         i += d-1;
+         v = u;
+         if (v>0xffff) {
+            v -= 0x10000;
+            n += utf8char(t+n,0xd800+(v >> 10));
+            v = 0xdc00+(v & 0x3ff);
+         }
+      } else if (v=='\\' && s[i+1]!='\0') {
+         i++;
+         switch (s[i]) {
+           case 'n': v = '\n'; break;
+           case 't': v = '\t'; break;
+           case 'r': v = '\r'; break;
+           case 'b': v = '\b'; break;
+           case 'f': v = '\f'; break;
+           case 'u':
+                v = 0;
+                for (d=0; d<4 && s[i+1]!='\0'; d++) {
+                    i++;
+                    if (s[i]>='0' && s[i]<='9') v = 16*v+s[i]-'0';
+                    else if (s[i]>='a' && s[i]<='f') v = 16*v+s[i]-'a'+10;
+                    else if (s[i]>='A' && s[i]<='F') v = 16*v+s[i]-'A'+10;
+                }
+                break;
+           default:
+                if (s[i]>='0' && s[i]<='7') {
+                   v = 0;
+                   for (d=0; d<3 && s[i]>='0' && s[i]<='7'; d++, i++) {
+                       v = 8*v+s[i]-'0';
+                   }
+                   i--;
+                } else {
+                   v = (unsigned char)s[i];
+                }
+                break;
+         }
+      }
+      n += utf8char(t+n,v);
+  }
+  t[n] = '\0';
+  return constant(CONSTANT_String,NULL,utf8(t),0);
+}
+
+
+/******  Instructions.  ******/
+
+int byteINDEX(BUFFER *b, int op, int index)
+{ if (b!=NULL) {
+     put1(b,op);
+     put2(b,index);
+  }
+  return 3;
+}
+
+/* op is the general form, short the _0 form */
+int byteLOCAL(BUFFER *b, int op, int shortop, int slot)
+{ if (slot<=3) {
+     if (b!=NULL) put1(b,shortop+slot);
+     return 1;
+  }
+  if (slot<=255) {
+     if (b!=NULL) {
+        put1(b,op);
+        put1(b,slot);
+     }
+     return 2;
+  }
+  if (b!=NULL) {
+     put1(b,0xc4); /* wide */
+     put1(b,op);
+     put2(b,slot);
+  }
+  return 4;
+}
+
+int byteLDC(BUFFER *b, int index)
+{ if (index<=255) {
+     if (b!=NULL) {
+        put1(b,0x12);
+        put1(b,index);
+     }
+     return 2;
+  }
+  return byteINDEX(b,0x13,index);
+}
+
+int byteBRANCH(BUFFER *b, int op, int label, int pc, int *labeloffset)
+{ int offset;
+  if (b!=NULL) {
+     offset = labeloffset[label]-pc;
+     if (offset < -32768 || offset > 32767) {
+        reportGlobalError("Branch too long for a class file");
+     }
+     put1(b,op);
+     put2(b,offset);
+  }
+  return 3;
+}
+
+/* returns the constant pool entry c refers to, or 0 if it has none */
+int bytePOOL(CODE *c)
+{ switch (c->kind) {
+    case newCK:
+         return classref(c->val.newC);
+    case instanceofCK:
+         return classref(c->val.instanceofC);
+    case checkcastCK:
+         return classref(c->val.checkcastC);
+    case ldc_intCK:
+         if (c->val.ldc_intC >= 0 && c->val.ldc_intC <= 5) return 0;
+         return constant(CONSTANT_Integer,NULL,c->val.ldc_intC,0);
+    case ldc_stringCK:
+         return stringref(c->val.ldc_stringC);
+    case getfieldCK:
+         return memberref(CONSTANT_Fieldref,c->val.getfieldC);
+    case putfieldCK:
+         return memberref(CONSTANT_Fieldref,c->val.putfieldC);
+    case invokevirtualCK:
+         return memberref(CONSTANT_Methodref,c->val.invokevirtualC);
+    case invokenonvirtualCK:
+         return memberref(CONSTANT_Methodref,c->val.invokenonvirtualC);
+    default:
+         return 0;
+  }
+}
+
+/* writes c, which starts at offset pc and refers to the constant pool
+ * entry index, into b and returns its length.  If b is NULL the
+ * instruction is only measured.
+ */
+int byteINSTR(BUFFER *b, CODE *c, int index, int pc, int *labeloffset)
+{ int op;
+  switch (c->kind) {
+    case nopCK:
+         op = 0x00;
+         break;
+    case i2cCK:
+         op = 0x92;
+         break;
+    case newCK:
+         return byteINDEX(b,0xbb,index);
+    case instanceofCK:
+         return byteINDEX(b,0xc1,index);
+    case checkcastCK:
+         return byteINDEX(b,0xc0,index);
+    case imulCK:
+         op = 0x68;
+         break;
+    case inegCK:
+         op = 0x74;
+         break;
+    case iremCK:
+         op = 0x70;
+         break;
+    case isubCK:
+         op = 0x64;
+         break;
+    case idivCK:
+         op = 0x6c;
+         break;
+    case iaddCK:
+         op = 0x60;
+         break;
+    case iincCK:
+         if (c->val.iincC.offset<=255 &&
+             c->val.iincC.amount>=-128 && c->val.iincC.amount<=127) {
+            if (b!=NULL) {
+               put1(b,0x84);
+               put1(b,c->val.iincC.offset);
+               put1(b,c->val.iincC.amount);
+            }
+            return 3;
+         }
+         if (b!=NULL) {
+            put1(b,0xc4); /* wide */
+            put1(b,0x84);
+            put2(b,c->val.iincC.offset);
+            put2(b,c->val.iincC.amount);
+         }
+         return 6;
+    case labelCK:
+         return 0;
+    case gotoCK:
+         return byteBRANCH(b,0xa7,c->val.gotoC,pc,labeloffset);
+    case ifeqCK:
+         return byteBRANCH(b,0x99,c->val.ifeqC,pc,labeloffset);
+    case ifneCK:
+         return byteBRANCH(b,0x9a,c->val.ifneC,pc,labeloffset);
+    case if_acmpeqCK:
+         return byteBRANCH(b,0xa5,c->val.if_acmpeqC,pc,labeloffset);
+    case if_acmpneCK:
+         return byteBRANCH(b,0xa6,c->val.if_acmpneC,pc,labeloffset);
+    case ifnullCK:
+         return byteBRANCH(b,0xc6,c->val.ifnullC,pc,labeloffset);
+    case ifnonnullCK:
+         return byteBRANCH(b,0xc7,c->val.ifnonnullC,pc,labeloffset);
+    case if_icmpeqCK:
+         return byteBRANCH(b,0x9f,c->val.if_icmpeqC,pc,labeloffset);
+    case if_icmpgtCK:
+         return byteBRANCH(b,0xa3,c->val.if_icmpgtC,pc,labeloffset);
+    case if_icmpltCK:
+         return byteBRANCH(b,0xa1,c->val.if_icmpltC,pc,labeloffset);
+    case if_icmpleCK:
+         return byteBRANCH(b,0xa4,c->val.if_icmpleC,pc,labeloffset);
+    case if_icmpgeCK:
+         return byteBRANCH(b,0xa2,c->val.if_icmpgeC,pc,labeloffset);
+    case if_icmpneCK:
+         return byteBRANCH(b,0xa0,c->val.if_icmpneC,pc,labeloffset);
+    case ireturnCK:
+         op = 0xac;
+         break;
+    case areturnCK:
+         op = 0xb0;
+         break;
+    case returnCK:
+         op = 0xb1;
+         break;
+    case aloadCK:
+         return byteLOCAL(b,0x19,0x2a,c->val.aloadC);
+    case astoreCK:
+         return byteLOCAL(b,0x3a,0x4b,c->val.astoreC);
+    case iloadCK:
+         return byteLOCAL(b,0x15,0x1a,c->val.iloadC);
+    case istoreCK:
+         return byteLOCAL(b,0x36,0x3b,c->val.istoreC);
+    case dupCK:
+         op = 0x59;
+         break;
+    case popCK:
+         op = 0x57;
+         break;
+    case swapCK:
+         op = 0x5f;
+         break;
+    case ldc_intCK:
+         if (c->val.ldc_intC >= 0 && c->val.ldc_intC <= 5) {
+            op = 0x03+c->val.ldc_intC;  /* iconst_<n> */
+            break;
+         }
+         return byteLDC(b,index);
+    case ldc_stringCK:
+         return byteLDC(b,index);
+    case aconst_nullCK:
+         op = 0x01;
+         break;
+    case getfieldCK:
+         return byteINDEX(b,0xb4,index);
+    case putfieldCK:
+         return byteINDEX(b,0xb5,index);
+    case invokevirtualCK:
+         return byteINDEX(b,0xb6,index);
+    case invokenonvirtualCK:
+         return byteINDEX(b,0xb7,index);
+    default:
+         op = 0x00;
+         break;
+  }
+  if (b!=NULL) put1(b,op);
+  return 1;
+}
+
+/* writes the bytecode of a method into b and returns its length.  A first
+ * pass enters the constants of the instructions in the pool and measures
+ * them to place the labels, the second one writes them with the branch
+ * offsets resolved.
+ */
+int byteCODE(BUFFER *b, CODE *code, int labels)
+{ CODE *c;
+  int *labeloffset,*index;
+  int pc,n;
+  labeloffset = (int *)Malloc((labels+1)*sizeof(int));
+  n = 0;
+  for (c=code; c!=NULL; c=c->next) n++;
+  index = (int *)Malloc((n+1)*sizeof(int));
+  pc = 0;
+  n = 0;
+  for (c=code; c!=NULL; c=c->next, n++) {
+      if (c->kind==labelCK) labeloffset[c->val.labelC] = pc;
+      index[n] = bytePOOL(c);
+      pc += byteINSTR(NULL,c,index[n],pc,labeloffset);
+  }
+  pc = 0;
+  n = 0;
+  for (c=code; c!=NULL; c=c->next, n++) {
+      pc += byteINSTR(b,c,index[n],pc,labeloffset);
+  }
+  free(index);
+  free(labeloffset);
+  return pc;
+}
+
+void byteCODEATTRIBUTE(CODE *code, int labels, int locals)
+{ int at,length;
+  put2(&body,utf8("Code"));
+  at = body.used;
+  put4(&body,0);                       /* attribute length */
+  put2(&body,limitCODE(code,labels));
+  put2(&body,locals);
+  put4(&body,0);                       /* code length */
+  length = byteCODE(&body,code,labels);
+  if (length>65535) reportGlobalError("Method too large for a class file");
+  patch4(&body,at+8,length);
+  put2(&body,0);                       /* exception table */
+  put2(&body,0);                       /* attributes */
+  patch4(&body,at,body.used-at-4);
+}
+
+
+/******  Classes and their members.  ******/
+
+char *bytename(char *file, char *class)
+{ int i;
+  char *e;
+  for (i=strlen(file); i>0 && file[i-1]!='/'; i--);
+  e = (char *)Malloc(i+strlen(class)+7);
+  strncpy(e,file,i);
+  e[i] = '\0';
+  strcat(e,class);
+  strcat(e,".class");
+  return e;
+}
+
+char *byteTYPE(TYPE *t)
+{ char *s;
+  switch (t->kind) {
+    case intK:
+         return "I";
+    case boolK:
+         return "Z";
+    case charK:
+         return "C";
+    case voidK:
+         return "V";
+    case refK:
+         s = (char *)Allocate(IRarena,strlen(t->class->signature)+3);
+         sprintf(s,"L%s;",t->class->signature);
+         return s;
+    case polynullK:
+         break;
+  }
+  return "";
+}
+
+int byteMODIFIER(ModifierKind modifier)
+{ switch (modifier) {
+    case noneMod:
+         break;
+    case finalMod:
+         return ACC_FINAL;
+    case abstractMod:
+         return ACC_ABSTRACT;
+    case synchronizedMod:
+         return ACC_SYNCHRONIZED;
+    case staticMod:
+         return ACC_STATIC;
+  }
+  return 0;
+}
+
+int countFIELD(FIELD *f)
+{ if (f==NULL) return 0;
+  return 1+countFIELD(f->next);
+}
+
+int countCONSTRUCTOR(CONSTRUCTOR *c)
+{ if (c==NULL) return 0;
+  return 1+countCONSTRUCTOR(c->next);
+}
+
+int countMETHOD(METHOD *m)
+{ if (m==NULL) return 0;
+  return 1+countMETHOD(m->next);
+}
+
+void bytePROGRAM(PROGRAM *p)
+{ if (p!=NULL) {
+     bytePROGRAM(p->next);
+     byteCLASSFILE(p->classfile,p->name);
+  }
+}
+
+void byteCLASSFILE(CLASSFILE *c, char *name)
+{ if (c!=NULL) {
+     byteCLASSFILE(c->next,name);
+     byteCLASS(c->class,name);
+  }
+}
+
+void byteCLASS(CLASS *c, char *name)
+{ FILE *f;
+  BUFFER head;
+  int i;
+  if (!c->external) {
+     for (i=0; i<PoolHashSize; i++) pooltable[i] = NULL;
+     poolcount = 1;
+     pool.used = 0;
+     body.used = 0;
+     put2(&body,ACC_PUBLIC | ACC_SUPER | byteMODIFIER(c->modifier));
+     put2(&body,classref(c->name));
+     put2(&body,classref(c->parent->signature));
+     put2(&body,0);                    /* interfaces */
+     put2(&body,countFIELD(c->fields));
+     byteFIELD(c->fields);
+     put2(&body,countCONSTRUCTOR(c->constructors)+countMETHOD(c->methods));
+     byteCONSTRUCTOR(c->constructors);
+     byteMETHOD(c->methods);
+     put2(&body,0);                    /* attributes */
+
+     head.data = NULL;
+     head.size = head.used = 0;
+     put2(&head,0xcafe);
+     put2(&head,0xbabe);
+     put2(&head,CLASSMINOR);
+     put2(&head,CLASSMAJOR);
+     put2(&head,poolcount);
+     if (poolcount>65535) {
+        reportStrGlobalError("Constant pool of %s too large for a class file",
+                             c->name);
+     } else if ((f = fopen(bytename(name,c->name),"wb"))==NULL) {
+        reportStrGlobalError("Unable to write class file for %s",c->name);
+     } else {
+        fwrite(head.data,1,head.used,f);
+        fwrite(pool.data,1,pool.used,f);
+        fwrite(body.data,1,body.used,f);
+        fclose(f);
+     }
+     free(head.data);
+  }
+}
+
+void byteFIELD(FIELD *f)
+{ if (f!=NULL) {
+     byteFIELD(f->next);
+     put2(&body,ACC_PROTECTED);
+     put2(&body,utf8(f->name));
+     put2(&body,utf8(byteTYPE(f->type)));
+     put2(&body,0);
+  }
+}
+
+void byteCONSTRUCTOR(CONSTRUCTOR *c)
+{ if (c!=NULL) {
+     byteCONSTRUCTOR(c->next);
+     put2(&body,ACC_PUBLIC);
+     put2(&body,utf8("<init>"));
+     put2(&body,utf8(c->signature));
+     put2(&body,1);
+     byteCODEATTRIBUTE(c->opcodes,c->labelcount,c->localslimit);
+  }
+}
+
+void byteMETHOD(METHOD *m)
+{ if (m!=NULL) {
+     byteMETHOD(m->next);
+     if (m->modifier==staticMod) {
+        put2(&body,ACC_PUBLIC | ACC_STATIC);
+        put2(&body,utf8("main"));
+        put2(&body,utf8("([Ljava/lang/String;)V"));
+     } else {
+        put2(&body,ACC_PUBLIC | byteMODIFIER(m->modifier));
+        put2(&body,utf8(m->name));
+        put2(&body,utf8(m->signature));
+     }
+     if (m->modifier!=abstractMod) {
+        put2(&body,1);
+        byteCODEATTRIBUTE(m->opcodes,m->labelcount,m->localslimit);
+     } else {
+        put2(&body,0);
+     }
+  }
+}
@@ -0,0 +1,20 @@
+/*
+ * JOOS is Copyright (C) 1997 Laurie Hendren & Michael I. Schwartzbach
+ *
+ * Reproduction of all or part of this software is permitted for
+ * educational or research use on condition that this copyright notice is
+ * included in any copy. This software comes with no warranty of any
+ * kind. In no event will the authors be liable for any damages resulting from
+ * use of this software.
+ *
+ * email: hendren@cs.mcgill.ca, mis@brics.dk
+ */
+
+#include "tree.h"
+
+void bytePROGRAM(PROGRAM *p);
+void byteCLASSFILE(CLASSFILE *c, char *name);
+void byteCLASS(CLASS *c, char *name);
+void byteFIELD(FIELD *f);
+void byteCONSTRUCTOR(CONSTRUCTOR *c);
+void byteMETHOD(METHOD *m);
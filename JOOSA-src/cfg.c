@@ -0,0 +1,221 @@
+/*
+ * JOOS is Copyright (C) 1997 Laurie Hendren & Michael I. Schwartzbach
+ *
+ * Reproduction of all or part of this software is permitted for
+ * educational or research use on condition that this copyright notice is
+ * included in any copy. This software comes with no warranty of any
+ * kind. In no event will the authors be liable for any damages resulting from
+ * use of this software.
+ *
+ * email: hendren@cs.mcgill.ca, mis@brics.dk
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "memory.h"
+#include "cfg.h"
+
+/* returns the label c may jump to, or -1 if c never jumps */
+int cfgtarget(CODE *c)
+{ switch (c->kind) {
+    case gotoCK:
+         return c->val.gotoC;
+    case ifeqCK:
+         return c->val.ifeqC;
+    case ifneCK:
+         return c->val.ifneC;
+    case if_acmpeqCK:
+         return c->val.if_acmpeqC;
+    case if_acmpneCK:
+         return c->val.if_acmpneC;
+    case ifnullCK:
+         return c->val.ifnullC;
+    case ifnonnullCK:
+         return c->val.ifnonnullC;
+    case if_icmpeqCK:
+         return c->val.if_icmpeqC;
+    case if_icmpgtCK:
+         return c->val.if_icmpgtC;
+    case if_icmpltCK:
+         return c->val.if_icmpltC;
+    case if_icmpleCK:
+         return c->val.if_icmpleC;
+    case if_icmpgeCK:
+         return c->val.if_icmpgeC;
+    case if_icmpneCK:
+         return c->val.if_icmpneC;
+    default:
+         return -1;
+  }
+}
+
+/* can control reach the instruction after c? */
+int cfgfallsthrough(CODE *c)
+{ return c->kind!=gotoCK && c->kind!=ireturnCK &&
+         c->kind!=areturnCK && c->kind!=returnCK;
+}
+
+void cfgaddedge(BLOCK *from, BLOCK *to)
+{ if (to==NULL) return;
+  if (from->succsize==1 && from->succ[0]==to) return;
+  from->succ[from->succsize++] = to;
+  to->predsize++;
+}
+
+/* numbers the blocks reachable from the entry in reverse postorder.  The
+ * search keeps its own stack, so long methods cannot overflow the C stack.
+ */
+void cfgorder(CFG *g)
+{ BLOCK **stack;
+  int *edge;
+  int i,top,post;
+  BLOCK *b;
+  stack = (BLOCK **)Malloc(g->size*sizeof(BLOCK *));
+  edge = (int *)Malloc(g->size*sizeof(int));
+  post = 0;
+  top = 0;
+  stack[0] = &g->blocks[0];
+  edge[0] = 0;
+  g->blocks[0].rpo = 0;
+  while (top>=0) {
+    b = stack[top];
+    if (edge[top] < b->succsize) {
+       b = b->succ[edge[top]++];
+       if (b->rpo==-1) {
+          b->rpo = 0;
+          top++;
+          stack[top] = b;
+          edge[top] = 0;
+       }
+    } else {
+       g->rpo[post++] = b;
+       top--;
+    }
+  }
+  g->rposize = post;
+  /* postorder was collected, turn it around */
+  for (i=0; i<post/2; i++) {
+      b = g->rpo[i];
+      g->rpo[i] = g->rpo[post-1-i];
+      g->rpo[post-1-i] = b;
+  }
+  for (i=0; i<post; i++) g->rpo[i]->rpo = i;
+  free(stack);
+  free(edge);
+}
+
+/* builds the graph of the code c, whose labels are numbered below labels */
+CFG *makeCFG(CODE *c, int labels)
+{ CFG *g;
+  CODE *p,*prev;
+  BLOCK *b;
+  BLOCK **preds;
+  int n,i,edges;
+  g = NEW(CFG);
+  g->labelsize = labels;
+  g->labelblock = (BLOCK **)Malloc((labels+1)*sizeof(BLOCK *));
+  for (i=0; i<labels; i++) g->labelblock[i] = NULL;
+
+  /* a block starts at the first instruction, at a label that does not
+   * follow another label, and after every jump or return.
+   */
+  n = 0;
+  prev = NULL;
+  for (p=c; p!=NULL; p=p->next) {
+      if (prev==NULL || (p->kind==labelCK && prev->kind!=labelCK) ||
+          cfgtarget(prev)!=-1 || !cfgfallsthrough(prev)) n++;
+      prev = p;
+  }
+  g->size = n;
+  g->blocks = (BLOCK *)Malloc((n+1)*sizeof(BLOCK));
+  g->rpo = (BLOCK **)Malloc((n+1)*sizeof(BLOCK *));
+  g->rposize = 0;
+
+  n = 0;
+  b = NULL;
+  prev = NULL;
+  for (p=c; p!=NULL; p=p->next) {
+      if (prev==NULL || (p->kind==labelCK && prev->kind!=labelCK) ||
+          cfgtarget(prev)!=-1 || !cfgfallsthrough(prev)) {
+         b = &g->blocks[n];
+         b->id = n++;
+         b->rpo = -1;
+         b->first = p;
+         b->succsize = 0;
+         b->predsize = 0;
+         b->pred = NULL;
+      }
+      b->last = p;
+      p->block = b->id;
+      if (p->kind==labelCK && p->val.labelC<labels) {
+         g->labelblock[p->val.labelC] = b;
+      }
+      prev = p;
+  }
+
+  edges = 0;
+  for (i=0; i<g->size; i++) {
+      b = &g->blocks[i];
+      if (cfgfallsthrough(b->last) && i+1<g->size) {
+         cfgaddedge(b,&g->blocks[i+1]);
+      }
+      n = cfgtarget(b->last);
+      if (n>=0 && n<labels) cfgaddedge(b,g->labelblock[n]);
+      edges += b->succsize;
+  }
+
+  /* all predecessor arrays share one allocation */
+  preds = (BLOCK **)Malloc((edges+1)*sizeof(BLOCK *));
+  for (i=0; i<g->size; i++) {
+      b = &g->blocks[i];
+      b->pred = preds;
+      preds += b->predsize;
+      b->predsize = 0;
+  }
+  for (i=0; i<g->size; i++) {
+      b = &g->blocks[i];
+      for (n=0; n<b->succsize; n++) {
+          b->succ[n]->pred[b->succ[n]->predsize++] = b;
+      }
+  }
+
+  if (g->size>0) cfgorder(g);
+  return g;
+}
+
+void freeCFG(CFG *g)
+{ if (g->size>0) free(g->blocks[0].pred);
+  free(g->blocks);
+  free(g->rpo);
+  free(g->labelblock);
+  free(g);
+}
+
+/* computes the maximum stack height of the code of g.  The blocks are
+ * simulated once each in reverse postorder, so every block but the first
+ * is reached from a block already done, and the height on entry to a block
+ * is the same along every path into it.  Unreachable blocks are not
+ * counted.
+ */
+int limitCFG(CFG *g)
+{ BLOCK *b;
+  CODE *p;
+  int *entry;
+  int i,j,height,limit,inc,affected,used;
+  if (g->rposize==0) return 0;
+  entry = (int *)Malloc(g->size*sizeof(int));
+  entry[g->rpo[0]->id] = 0;
+  limit = 0;
+  for (i=0; i<g->rposize; i++) {
+      b = g->rpo[i];
+      height = entry[b->id];
+      for (p=b->first; p!=b->last->next; p=p->next) {
+          effectCODE(p,&inc,&affected,&used);
+          height += inc;
+          if (height>limit) limit = height;
+      }
+      for (j=0; j<b->succsize; j++) entry[b->succ[j]->id] = height;
+  }
+  free(entry);
+  return limit;
+}
@@ -0,0 +1,42 @@
+/*
+ * JOOS is Copyright (C) 1997 Laurie Hendren & Michael I. Schwartzbach
+ *
+ * Reproduction of all or part of this software is permitted for
+ * educational or research use on condition that this copyright notice is
+ * included in any copy. This software comes with no warranty of any
+ * kind. In no event will the authors be liable for any damages resulting from
+ * use of this software.
+ *
+ * email: hendren@cs.mcgill.ca, mis@brics.dk
+ */
+
+#include "tree.h"
+
+/* A basic block is a maximal run of instructions from first to last that
+ * is only entered at first and only left after last.  Blocks are numbered
+ * in the order they appear in the code, and makeCFG stores the number of
+ * its block in the block field of every instruction.
+ */
+typedef struct BLOCK {
+   int id;
+   int rpo;                /* reverse postorder number, -1 if unreachable */
+   struct CODE *first;
+   struct CODE *last;
+   int succsize;
+   struct BLOCK *succ[2];  /* fall-through successor first */
+   int predsize;
+   struct BLOCK **pred;
+} BLOCK;
+
+typedef struct CFG {
+   int size;
+   BLOCK *blocks;
+   int rposize;
+   BLOCK **rpo;            /* the reachable blocks in reverse postorder */
+   int labelsize;
+   BLOCK **labelblock;     /* block of each label, NULL if not in the code */
+} CFG;
+
+CFG *makeCFG(CODE *c, int labels);
+void freeCFG(CFG *g);
+int limitCFG(CFG *g);
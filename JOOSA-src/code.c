@@ -11,23 +11,22 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "memory.h"
 #include "code.h"
 #include "symbol.h"
 
-CODE *currentcode;
-CODE *currenttail;
+extern TYPE *stringTYPE;
+
+/* the target of a condition that continues with the next instruction */
+#define FALLTHROUGH -1
+
 LABEL *currentlabels;
 
+/* the instructions of a method are buffered by tree.c until it is done */
 void appendCODE(CODE *c)
-{ if (currentcode==NULL) {
-     currentcode = c;
-     currenttail = c;
-  } else {
-     currenttail->next = c;
-     currenttail = c;
-  }
+{ keepCODE(c);
 }
 
 void code_nop()
@@ -74,12 +73,10 @@ void code_iadd()
 { appendCODE(makeCODEiadd(NULL));
 }
 
-CODE *code_label(char *name, int label)
+void code_label(char *name, int label)
 { currentlabels[label].name = name;
   currentlabels[label].sources = 1;
   appendCODE(makeCODElabel(label,NULL));
-  currentlabels[label].position = currenttail;
-  return currenttail;
 }
 
 void code_goto(int label)
@@ -202,36 +199,39 @@ void code_invokenonvirtual(char *arg)
 { appendCODE(makeCODEinvokenonvirtual(arg,NULL));
 }
 
+/* change of the stack height made by c */
+int stackCODE(CODE *c)
+{ int inc,affected,used;
+  effectCODE(c,&inc,&affected,&used);
+  return inc;
+}
+
+/* descriptors and invoke targets are built again for every use, so the
+ * result is interned and equal descriptors share one string.
+ */
+char *strcat5(char *s1, char *s2, char *s3, char *s4, char *s5)
+{ char *s,*t;
+  s = (char *)Malloc(strlen(s1)+strlen(s2)+strlen(s3)+strlen(s4)+strlen(s5)+1);
+  sprintf(s,"%s%s%s%s%s",s1,s2,s3,s4,s5);
+  t = intern(s);
+  free(s);
+  return t;
+}
+
 char *strcat2(char *s1, char *s2)
-{ char *s;
-  s = (char *)Malloc(strlen(s1)+strlen(s2)+1);
-  sprintf(s,"%s%s",s1,s2);
-  return s;
+{ return strcat5(s1,s2,"","","");
 }
 
 char *strcat3(char *s1, char *s2, char *s3)
-{ char *s;
-  s = (char *)Malloc(strlen(s1)+strlen(s2)+strlen(s3)+1);
-  sprintf(s,"%s%s%s",s1,s2,s3);
-  return s;
+{ return strcat5(s1,s2,s3,"","");
 }
 
 char *strcat4(char *s1, char *s2, char *s3, char *s4)
-{ char *s;
-  s = (char *)Malloc(strlen(s1)+strlen(s2)+strlen(s3)+strlen(s4)+1);
-  sprintf(s,"%s%s%s%s",s1,s2,s3,s4);
-  return s;
-}
-
-char *strcat5(char *s1, char *s2, char *s3, char *s4, char *s5)
-{ char *s;
-  s = (char *)Malloc(strlen(s1)+strlen(s2)+strlen(s3)+strlen(s4)+strlen(s5)+1);
-  sprintf(s,"%s%s%s%s%s",s1,s2,s3,s4,s5);
-  return s;
+{ return strcat5(s1,s2,s3,s4,"");
 }
 
 char *codePackage(char *package)
-{ char *p;
+{ char *p,*t;
   int i;
   p = (char *)Malloc(strlen(package)+2);
   for (i=0; i<strlen(package); i++) {
@@ -239,7 +239,9 @@ char *codePackage(char *package)
   }
   p[i] = '/';
   p[i+1] = '\0';
-  return p;
+  t = intern(p);
+  free(p);
+  return t;
 }
 
 char *codeClassname(CLASS *c)
@@ -323,12 +325,12 @@ void codeCLASS(CLASS *c)
 void codeCONSTRUCTOR(CONSTRUCTOR *c)
 { if (c!=NULL) {
      codeCONSTRUCTOR(c->next);
-     currentcode = NULL;
-     c->labels = Malloc(c->labelcount*sizeof(LABEL));
+     openCODE();
+     c->labels = Allocate(IRarena,c->labelcount*sizeof(LABEL));
      currentlabels = c->labels;
      codeSTATEMENT(c->statements);
      code_return();
-     c->opcodes = currentcode;
+     c->opcodes = closeCODE(c->labels);
      c->signature = codeConstructorSignature(c->formals);
   }
 }
@@ -336,8 +338,8 @@ void codeCONSTRUCTOR(CONSTRUCTOR *c)
 void codeMETHOD(METHOD *m)
 { if (m!=NULL) {
      codeMETHOD(m->next);
-     currentcode = NULL;
-     m->labels = Malloc(m->labelcount*sizeof(LABEL));
+     openCODE();
+     m->labels = Allocate(IRarena,m->labelcount*sizeof(LABEL));
      currentlabels = m->labels;
      codeSTATEMENT(m->statements);
      if (m->returntype->kind==voidK) {
@@ -345,7 +347,7 @@ void codeMETHOD(METHOD *m)
      } else {
         code_nop();
      }
-     m->opcodes = currentcode;
+     m->opcodes = closeCODE(m->labels);
      m->signature = codeSignature(m->formals,m->returntype);
   }
 }
@@ -381,14 +383,12 @@ void codeSTATEMENT(STATEMENT *s)
             codeSTATEMENT(s->val.sequenceS.second);
             break;
        case ifK:
-            codeEXP(s->val.ifS.condition);
-            code_ifeq(s->val.ifS.stoplabel);
+            codeCOND(s->val.ifS.condition,FALLTHROUGH,s->val.ifS.stoplabel);
             codeSTATEMENT(s->val.ifS.body);
             code_label("stop",s->val.ifS.stoplabel);
             break;
        case ifelseK:
-            codeEXP(s->val.ifelseS.condition);
-            code_ifeq(s->val.ifelseS.elselabel);
+            codeCOND(s->val.ifelseS.condition,FALLTHROUGH,s->val.ifelseS.elselabel);
             codeSTATEMENT(s->val.ifelseS.thenpart);
             code_goto(s->val.ifelseS.stoplabel);
             code_label("else",s->val.ifelseS.elselabel);
@@ -396,12 +396,14 @@ void codeSTATEMENT(STATEMENT *s)
             code_label("stop",s->val.ifelseS.stoplabel);
             break;
        case whileK:
-            code_label("start",s->val.whileS.startlabel);
-            codeEXP(s->val.whileS.condition);
-            code_ifeq(s->val.whileS.stoplabel);
+            /* the test is placed after the body, so an iteration costs
+             * only the branch back to the body
+             */
+            code_goto(s->val.whileS.testlabel);
+            code_label("loop",s->val.whileS.looplabel);
             codeSTATEMENT(s->val.whileS.body);
-            code_goto(s->val.whileS.startlabel);
-            code_label("stop",s->val.whileS.stoplabel);
+            code_label("test",s->val.whileS.testlabel);
+            codeCOND(s->val.whileS.condition,s->val.whileS.looplabel,FALLTHROUGH);
             break;
        case blockK:
             codeSTATEMENT(s->val.blockS.body);
@@ -708,9 +710,9 @@ void codeEXP(EXP *e)
        case refK:
             code_dup();
             code_ifnull(e->nulllabel);
-            if (strcmp(e->type->name,"String")!=0) {
+            if (e->type->name!=stringTYPE->name) {
                CLASS *c;
-               c = lookupHierarchyClass("toString",e->type->class);
+               c = lookupHierarchyClass(intern("toString"),e->type->class);
                code_invokevirtual(strcat2(codeClassname(c),
                                           "/toString()Ljava/lang/String;"));
             }
@@ -727,6 +729,103 @@ void codeEXP(EXP *e)
   }
 }
 
+/* ends a test, whose outcome is decided by the branch ontrue, or by
+ * onfalse when the true case falls through
+ */
+void codeJUMP(void (*ontrue)(int), void (*onfalse)(int),
+              int truelabel, int falselabel)
+{ if (truelabel!=FALLTHROUGH) {
+     (*ontrue)(truelabel);
+     if (falselabel!=FALLTHROUGH) code_goto(falselabel);
+  } else {
+     (*onfalse)(falselabel);
+  }
+}
+
+/* codes the condition e as jumps to truelabel when it holds and to
+ * falselabel when it does not, with no 0 or 1 left on the stack.  One of
+ * the two may be FALLTHROUGH, for the case that continues with the code
+ * after the condition, but not both.
+ */
+void codeCOND(EXP *e, int truelabel, int falselabel)
+{ switch(e->kind) {
+    case orK:
+         if (truelabel==FALLTHROUGH) {
+            codeCOND(e->val.orE.left,e->val.orE.truelabel,FALLTHROUGH);
+            codeCOND(e->val.orE.right,FALLTHROUGH,falselabel);
+            code_label("true",e->val.orE.truelabel);
+         } else {
+            codeCOND(e->val.orE.left,truelabel,FALLTHROUGH);
+            codeCOND(e->val.orE.right,truelabel,falselabel);
+         }
+         break;
+    case andK:
+         if (falselabel==FALLTHROUGH) {
+            codeCOND(e->val.andE.left,FALLTHROUGH,e->val.andE.falselabel);
+            codeCOND(e->val.andE.right,truelabel,FALLTHROUGH);
+            code_label("false",e->val.andE.falselabel);
+         } else {
+            codeCOND(e->val.andE.left,FALLTHROUGH,falselabel);
+            codeCOND(e->val.andE.right,truelabel,falselabel);
+         }
+         break;
+    case notK:
+         codeCOND(e->val.notE.not,falselabel,truelabel);
+         break;
+    case eqK:
+         codeEXP(e->val.eqE.left);
+         codeEXP(e->val.eqE.right);
+         if (e->val.eqE.left->type->kind==refK ||
+             e->val.eqE.left->type->kind==polynullK) {
+            codeJUMP(code_if_acmpeq,code_if_acmpne,truelabel,falselabel);
+         } else {
+            codeJUMP(code_if_icmpeq,code_if_icmpne,truelabel,falselabel);
+         }
+         break;
+    case neqK:
+         codeEXP(e->val.neqE.left);
+         codeEXP(e->val.neqE.right);
+         if (e->val.neqE.left->type->kind==refK ||
+             e->val.neqE.left->type->kind==polynullK) {
+            codeJUMP(code_if_acmpne,code_if_acmpeq,truelabel,falselabel);
+         } else {
+            codeJUMP(code_if_icmpne,code_if_icmpeq,truelabel,falselabel);
+         }
+         break;
+    case ltK:
+         codeEXP(e->val.ltE.left);
+         codeEXP(e->val.ltE.right);
+         codeJUMP(code_if_icmplt,code_if_icmpge,truelabel,falselabel);
+         break;
+    case gtK:
+         codeEXP(e->val.gtE.left);
+         codeEXP(e->val.gtE.right);
+         codeJUMP(code_if_icmpgt,code_if_icmple,truelabel,falselabel);
+         break;
+    case leqK:
+         codeEXP(e->val.leqE.left);
+         codeEXP(e->val.leqE.right);
+         codeJUMP(code_if_icmple,code_if_icmpgt,truelabel,falselabel);
+         break;
+    case geqK:
+         codeEXP(e->val.geqE.left);
+         codeEXP(e->val.geqE.right);
+         codeJUMP(code_if_icmpge,code_if_icmplt,truelabel,falselabel);
+         break;
+    case boolconstK:
+         if (e->val.boolconstE) {
+            if (truelabel!=FALLTHROUGH) code_goto(truelabel);
+         } else {
+            if (falselabel!=FALLTHROUGH) code_goto(falselabel);
+         }
+         break;
+    default:
+         codeEXP(e);
+         codeJUMP(code_ifne,code_ifeq,truelabel,falselabel);
+         break;
+  }
+}
+
 void codeRECEIVER(RECEIVER *r)
 { switch(r->kind) {
     case objectK:
@@ -19,5 +19,7 @@ void codeCONSTRUCTOR(CONSTRUCTOR *c);
 void codeMETHOD(METHOD *m);
 void codeSTATEMENT(STATEMENT *s);
 void codeEXP(EXP *e);
+void codeCOND(EXP *e, int truelabel, int falselabel);
 void codeRECEIVER(RECEIVER *r);
 void codeARGUMENT(ARGUMENT *a);
+int stackCODE(CODE *c);
@@ -17,52 +17,64 @@
 
 extern char *currentfile;
 
-ASNSET *setUniversal()
+int setwords;
+ASNSET *freesets;
+
+ASNSET *setNew()
 { ASNSET *a;
-  a = NEW(ASNSET);
-  a->kind = universalK;
+  if (freesets!=NULL) {
+     a = freesets;
+     freesets = a->next;
+  } else {
+     a = NEWIN(ASTarena,ASNSET);
+     a->bits = (unsigned *)Allocate(ASTarena,setwords*sizeof(unsigned));
+  }
   return a;
 }
 
-int setMember(ASNSET *s,LOCAL *l)
-{ if (s==NULL) return 0;
-  if (s->kind==universalK) return 1;
-  if (s->kind==singleK && s->val.singleS==l) return 1;
-  if (s->kind==intersectK && setMember(s->val.intersectS.first,l) 
-                          && setMember(s->val.intersectS.second,l)) return 1;
-  if (s->kind==unionK && (setMember(s->val.unionS.first,l) ||
-                          setMember(s->val.unionS.second,l))) return 1;
-  return setMember(s->next,l);
+void setFree(ASNSET *a)
+{ a->next = freesets;
+  freesets = a;
 }
 
-ASNSET *setInsert(ASNSET *s,LOCAL *l)
-{ ASNSET *a;
-  if (setMember(s,l)) return s;
-  a = NEW(ASNSET);
-  a->kind = singleK;
-  a->val.singleS = l;
-  a->next = s;
-  return a;
+void setEmpty(ASNSET *a)
+{ int i;
+  for (i=0; i<setwords; i++) a->bits[i] = 0;
 }
 
-ASNSET *setIntersect(ASNSET *l1, ASNSET *l2)
-{ ASNSET *a;
-  a = NEW(ASNSET);
-  a->kind = intersectK;
-  a->val.intersectS.first = l1;
-  a->val.intersectS.second = l2;
-  a->next = NULL;
-  return a;
+void setUniversal(ASNSET *a)
+{ int i;
+  for (i=0; i<setwords; i++) a->bits[i] = ~0U;
 }
 
-ASNSET *setUnion(ASNSET *l1, ASNSET *l2)
-{ ASNSET *a;
-  a = NEW(ASNSET);
-  a->kind = unionK;
-  a->val.unionS.first = l1;
-  a->val.unionS.second = l2;
-  a->next = NULL;
-  return a;
+void setCopy(ASNSET *a, ASNSET *b)
+{ int i;
+  for (i=0; i<setwords; i++) a->bits[i] = b->bits[i];
+}
+
+void setSwap(ASNSET *a, ASNSET *b)
+{ unsigned *t;
+  t = a->bits;
+  a->bits = b->bits;
+  b->bits = t;
+}
+
+int setMember(ASNSET *a, LOCAL *l)
+{ return (a->bits[l->index/32] >> (l->index%32)) & 1;
+}
+
+void setInsert(ASNSET *a, LOCAL *l)
+{ a->bits[l->index/32] |= 1U << (l->index%32);
+}
+
+void setIntersect(ASNSET *a, ASNSET *b)
+{ int i;
+  for (i=0; i<setwords; i++) a->bits[i] &= b->bits[i];
+}
+
+void setUnion(ASNSET *a, ASNSET *b)
+{ int i;
+  for (i=0; i<setwords; i++) a->bits[i] |= b->bits[i];
 }
 
 void defasnPROGRAM(PROGRAM *p) 
@@ -88,240 +100,274 @@ void defasnCLASS(CLASS *c)
 void defasnCONSTRUCTOR(CONSTRUCTOR *c)
 { if (c!=NULL) {
      defasnCONSTRUCTOR(c->next);
-     (void)defasnSTATEMENT(c->statements,NULL);
+     defasnBODY(c->statements);
   }
 }
 
 void defasnMETHOD(METHOD *m)
 { if (m!=NULL) {
      defasnMETHOD(m->next);
-     (void)defasnSTATEMENT(m->statements,NULL);
+     defasnBODY(m->statements);
+  }
+}
+
+void defasnBODY(STATEMENT *s)
+{ ASNSET *a;
+  setwords = defasnLOCAL(s,0)/32+1;
+  freesets = NULL;
+  a = setNew();
+  setEmpty(a);
+  defasnSTATEMENT(s,a);
+}
+
+/* numbers the locals declared in s from n, and returns the next number */
+int defasnLOCAL(STATEMENT *s, int n)
+{ LOCAL *l;
+  if (s!=NULL) {
+     switch (s->kind) {
+       case localK:
+            for (l = s->val.localS; l!=NULL; l = l->next) l->index = n++;
+            break;
+       case sequenceK:
+            n = defasnLOCAL(s->val.sequenceS.first,n);
+            n = defasnLOCAL(s->val.sequenceS.second,n);
+            break;
+       case ifK:
+            n = defasnLOCAL(s->val.ifS.body,n);
+            break;
+       case ifelseK:
+            n = defasnLOCAL(s->val.ifelseS.thenpart,n);
+            n = defasnLOCAL(s->val.ifelseS.elsepart,n);
+            break;
+       case whileK:
+            n = defasnLOCAL(s->val.whileS.body,n);
+            break;
+       case blockK:
+            n = defasnLOCAL(s->val.blockS.body,n);
+            break;
+       default:
+            break;
+     }
   }
+  return n;
 }
 
-ASNSET *defasnSTATEMENT(STATEMENT *s, ASNSET *before)
-{ if (s!=NULL) {
+/* a is the set before s, and is updated to the set after s */
+void defasnSTATEMENT(STATEMENT *s, ASNSET *a)
+{ ASNSET *f;
+  if (s!=NULL) {
      switch (s->kind) {
        case skipK:
-            return before;
+            break;
        case localK:
-            return before;
+            break;
        case expK:
-            return defasnEXP(s->val.expS,before);
+            defasnEXP(s->val.expS,a);
+            break;
        case returnK:
-            if (s->val.returnS!=NULL) (void)defasnEXP(s->val.returnS,before);
-            return setUniversal();
+            if (s->val.returnS!=NULL) defasnEXP(s->val.returnS,a);
+            setUniversal(a);
+            break;
        case sequenceK:
-            return defasnSTATEMENT(s->val.sequenceS.second,
-                      defasnSTATEMENT(s->val.sequenceS.first,before)
-                   );
+            defasnSTATEMENT(s->val.sequenceS.first,a);
+            defasnSTATEMENT(s->val.sequenceS.second,a);
+            break;
        case ifK:
-            return setIntersect(
-                      defasnEXPassume(s->val.ifS.condition,before,0),
-                      defasnSTATEMENT(s->val.ifS.body,
-                         defasnEXPassume(s->val.ifS.condition,before,1)
-                      )
-                   );
+            f = setNew();
+            defasnCOND(s->val.ifS.condition,a,f);
+            defasnSTATEMENT(s->val.ifS.body,a);
+            setIntersect(a,f);
+            setFree(f);
+            break;
        case ifelseK:
-            return setIntersect(
-                      defasnSTATEMENT(s->val.ifelseS.thenpart,
-                         defasnEXPassume(s->val.ifelseS.condition,before,1)
-                      ),
-                      defasnSTATEMENT(s->val.ifelseS.elsepart,
-                         defasnEXPassume(s->val.ifelseS.condition,before,0)
-                      )
-                   );
+            f = setNew();
+            defasnCOND(s->val.ifelseS.condition,a,f);
+            defasnSTATEMENT(s->val.ifelseS.thenpart,a);
+            defasnSTATEMENT(s->val.ifelseS.elsepart,f);
+            setIntersect(a,f);
+            setFree(f);
+            break;
        case whileK:
-            return setIntersect(
-                      defasnEXPassume(s->val.whileS.condition,before,0),
-                      defasnSTATEMENT(s->val.whileS.body,
-                         defasnEXPassume(s->val.whileS.condition,before,1)
-                      )
-                   );
+            f = setNew();
+            defasnCOND(s->val.whileS.condition,a,f);
+            defasnSTATEMENT(s->val.whileS.body,a);
+            setIntersect(a,f);
+            setFree(f);
+            break;
        case blockK:
-            return defasnSTATEMENT(s->val.blockS.body,before);
+            defasnSTATEMENT(s->val.blockS.body,a);
+            break;
        case superconsK:
-            return defasnARGUMENT(s->val.superconsS.args,before);
+            defasnARGUMENT(s->val.superconsS.args,a);
+            break;
      }
   }
-  return before;
 }
 
-ASNSET *defasnEXPassume(EXP *e, ASNSET *before, int assume)
-{ switch(e->kind) {
-    case idK:
-         if (e->val.idE.idsym->kind==localSym &&
-             !setMember(before,e->val.idE.idsym->val.localS)) {
-             reportStrError("variable %s may not have been initialized",
-                            e->val.idE.name,e->lineno);
-         }
-         return before;
+/* a is the set before the condition e.  Afterwards a is the set when e
+ * is true and f the set when e is false.
+ */
+void defasnCOND(EXP *e, ASNSET *a, ASNSET *f)
+{ ASNSET *t,*g;
+  switch(e->kind) {
     case assignK:
-         switch (e->val.assignE.leftsym->kind) {
-           case localSym:
-                return setInsert(
-                          defasnEXPassume(e->val.assignE.right,before,assume),
-                          e->val.assignE.leftsym->val.localS
-                       );
-           case formalSym:
-           case fieldSym:
-           case classSym:
-           case methodSym:
-                return defasnEXPassume(e->val.assignE.right,before,assume);
+         defasnCOND(e->val.assignE.right,a,f);
+         if (e->val.assignE.leftsym->kind==localSym) {
+            setInsert(a,e->val.assignE.leftsym->val.localS);
+            setInsert(f,e->val.assignE.leftsym->val.localS);
          }
+         break;
     case orK:
-         if (assume) {
-            return setIntersect(
-                      defasnEXPassume(e->val.orE.left,before,1),
-                      defasnEXPassume(e->val.orE.right,
-                         defasnEXPassume(e->val.orE.left,before,0),1
-                      )
-                   );
-         } else {
-            return setUnion(
-                      defasnEXPassume(e->val.orE.left,before,0),
-                      defasnEXPassume(e->val.orE.right,
-                         defasnEXPassume(e->val.orE.left,before,0),0
-                      )
-                   );
-         }
+         defasnCOND(e->val.orE.left,a,f);
+         t = setNew();
+         g = setNew();
+         setCopy(t,f);
+         defasnCOND(e->val.orE.right,t,g);
+         setIntersect(a,t);
+         setUnion(f,g);
+         setFree(g);
+         setFree(t);
+         break;
     case andK:
-         if (assume) {
-            return setUnion(
-                      defasnEXPassume(e->val.orE.left,before,1),
-                      defasnEXPassume(e->val.orE.right,
-                         defasnEXPassume(e->val.orE.left,before,1),1
-                      )
-                   );
-         } else {
-            return setIntersect(
-                      defasnEXPassume(e->val.orE.left,before,0),
-                      defasnEXPassume(e->val.orE.right,
-                         defasnEXPassume(e->val.orE.left,before,1),0
-                      )
-                   );
-         }
+         defasnCOND(e->val.andE.left,a,f);
+         t = setNew();
+         g = setNew();
+         setCopy(t,a);
+         defasnCOND(e->val.andE.right,t,g);
+         setUnion(a,t);
+         setIntersect(f,g);
+         setFree(g);
+         setFree(t);
+         break;
     case notK:
-         return defasnEXPassume(e->val.notE.not,before,!assume);
+         defasnCOND(e->val.notE.not,a,f);
+         setSwap(a,f);
+         break;
     case boolconstK:
-         if (e->val.boolconstE!=assume) return setUniversal();
-         else return before;
+         if (e->val.boolconstE) {
+            setUniversal(f);
+         } else {
+            setCopy(f,a);
+            setUniversal(a);
+         }
+         break;
     default: 
-         return defasnEXP(e,before);
+         defasnEXP(e,a);
+         setCopy(f,a);
+         break;
   }
 }
 
-ASNSET *defasnEXP(EXP *e, ASNSET *before)
-{ switch(e->kind) {
+void defasnEXP(EXP *e, ASNSET *a)
+{ ASNSET *f;
+  switch(e->kind) {
     case idK:
          if (e->val.idE.idsym->kind==localSym &&
-             !setMember(before,e->val.idE.idsym->val.localS)) {
+             !setMember(a,e->val.idE.idsym->val.localS)) {
              reportStrError("variable %s may not have been initialized",
                             e->val.idE.name,e->lineno);
          }
-         return before;
+         break;
     case assignK:
-         switch (e->val.assignE.leftsym->kind) {
-           case localSym:
-                return setInsert(
-                          defasnEXP(e->val.assignE.right,before),
-                          e->val.assignE.leftsym->val.localS
-                       );
-           case formalSym:
-           case fieldSym:
-           case classSym:
-           case methodSym:
-                return defasnEXP(e->val.assignE.right,before);
+         defasnEXP(e->val.assignE.right,a);
+         if (e->val.assignE.leftsym->kind==localSym) {
+            setInsert(a,e->val.assignE.leftsym->val.localS);
          }
+         break;
     case plusK:
-         return defasnEXP(e->val.plusE.right,
-                  defasnEXP(e->val.plusE.left,before)
-                );
+         defasnEXP(e->val.plusE.left,a);
+         defasnEXP(e->val.plusE.right,a);
+         break;
     case minusK:
-         return defasnEXP(e->val.minusE.right,
-                  defasnEXP(e->val.minusE.left,before)
-                );
+         defasnEXP(e->val.minusE.left,a);
+         defasnEXP(e->val.minusE.right,a);
+         break;
     case timesK:
-         return defasnEXP(e->val.timesE.right,
-                  defasnEXP(e->val.timesE.left,before)
-                );
+         defasnEXP(e->val.timesE.left,a);
+         defasnEXP(e->val.timesE.right,a);
+         break;
     case divK:
-         return defasnEXP(e->val.divE.right,
-                  defasnEXP(e->val.divE.left,before)
-                );
+         defasnEXP(e->val.divE.left,a);
+         defasnEXP(e->val.divE.right,a);
+         break;
     case modK:
-         return defasnEXP(e->val.modE.right,
-                  defasnEXP(e->val.modE.left,before)
-                );
+         defasnEXP(e->val.modE.left,a);
+         defasnEXP(e->val.modE.right,a);
+         break;
     case eqK:
-         return defasnEXP(e->val.eqE.right,
-                  defasnEXP(e->val.eqE.left,before)
-                );
+         defasnEXP(e->val.eqE.left,a);
+         defasnEXP(e->val.eqE.right,a);
+         break;
     case ltK:
-         return defasnEXP(e->val.ltE.right,
-                  defasnEXP(e->val.ltE.left,before)
-                );
+         defasnEXP(e->val.ltE.left,a);
+         defasnEXP(e->val.ltE.right,a);
+         break;
     case gtK:
-         return defasnEXP(e->val.gtE.right,
-                  defasnEXP(e->val.gtE.left,before)
-                );
+         defasnEXP(e->val.gtE.left,a);
+         defasnEXP(e->val.gtE.right,a);
+         break;
     case geqK:
-         return defasnEXP(e->val.geqE.right,
-                  defasnEXP(e->val.geqE.left,before)
-                );
+         defasnEXP(e->val.geqE.left,a);
+         defasnEXP(e->val.geqE.right,a);
+         break;
     case leqK:
-         return defasnEXP(e->val.leqE.right,
-                  defasnEXP(e->val.leqE.left,before)
-                );
+         defasnEXP(e->val.leqE.left,a);
+         defasnEXP(e->val.leqE.right,a);
+         break;
     case neqK:
-         return defasnEXP(e->val.neqE.right,
-                  defasnEXP(e->val.neqE.left,before)
-                );
+         defasnEXP(e->val.neqE.left,a);
+         defasnEXP(e->val.neqE.right,a);
+         break;
     case uminusK:
-         return defasnEXP(e->val.uminusE,before);
+         defasnEXP(e->val.uminusE,a);
+         break;
     case thisK:
-         return before;
+         break;
     case newK:
-         return defasnARGUMENT(e->val.newE.args,before);
+         defasnARGUMENT(e->val.newE.args,a);
+         break;
     case instanceofK:
-         return defasnEXP(e->val.instanceofE.left,before);
+         defasnEXP(e->val.instanceofE.left,a);
+         break;
     case invokeK:
-         return defasnARGUMENT(e->val.newE.args,
-                  defasnRECEIVER(e->val.invokeE.receiver,before)
-                );
+         defasnRECEIVER(e->val.invokeE.receiver,a);
+         defasnARGUMENT(e->val.invokeE.args,a);
+         break;
     case intconstK:
-         return before;
     case charconstK:
-         return before;
     case stringconstK:
-         return before;
     case nullK:
-         return before;
+         break;
     case castK:
-         return defasnEXP(e->val.castE.right,before);
+         defasnEXP(e->val.castE.right,a);
+         break;
     case charcastK:
-         return defasnEXP(e->val.charcastE,before);
+         defasnEXP(e->val.charcastE,a);
+         break;
     default: 
-         if (e->type->kind==boolK)
-            return setIntersect(defasnEXPassume(e,before,1),defasnEXPassume(e,before,0));
-         else 
-            return before;
+         if (e->type->kind==boolK) {
+            f = setNew();
+            defasnCOND(e,a,f);
+            setIntersect(a,f);
+            setFree(f);
+         }
+         break;
   }
 }
 
-ASNSET *defasnRECEIVER(RECEIVER *r, ASNSET *before)
+void defasnRECEIVER(RECEIVER *r, ASNSET *a)
 { switch(r->kind) {
     case objectK:
-         return defasnEXP(r->objectR,before);
+         defasnEXP(r->objectR,a);
+         break;
     case superK:
-         return before;
+         break;
   }
-  return before;
 }
 
-ASNSET *defasnARGUMENT(ARGUMENT *a, ASNSET *before)
-{ if (a!=NULL) 
-     return defasnEXP(a->exp,defasnARGUMENT(a->next,before));
-  else 
-     return before;
+void defasnARGUMENT(ARGUMENT *a, ASNSET *set)
+{ if (a!=NULL) {
+     defasnARGUMENT(a->next,set);
+     defasnEXP(a->exp,set);
+  }
 }
@@ -12,14 +12,14 @@
 
 #include "tree.h"
 
+/* The locals of a method are numbered from 0 by defasnLOCAL, and a set of
+ * definitely assigned locals is a bitset over those numbers.  Sets are
+ * updated in place and recycled, so the analysis allocates only as many
+ * sets as are live at once.
+ */
 typedef struct ASNSET {
-  enum {singleK,intersectK,unionK,universalK} kind;
-  union {
-    struct LOCAL *singleS;
-    struct {struct ASNSET *first,*second;} intersectS;
-    struct {struct ASNSET *first,*second;} unionS;
-  } val;
-  struct ASNSET *next; 
+  unsigned *bits;
+  struct ASNSET *next;
 } ASNSET;
 
 void defasnPROGRAM(PROGRAM *p);
@@ -27,9 +27,10 @@ void defasnCLASSFILE(CLASSFILE *c);
 void defasnCLASS(CLASS *c);
 void defasnCONSTRUCTOR(CONSTRUCTOR *c);
 void defasnMETHOD(METHOD *m);
-ASNSET *defasnSTATEMENT(STATEMENT *s, ASNSET *before);
-ASNSET *defasnEXPassume(EXP *e, ASNSET *before, int assume);
-ASNSET *defasnEXP(EXP *e, ASNSET *before);
-ASNSET *defasnRECEIVER(RECEIVER *r, ASNSET *before);
-ASNSET *defasnARGUMENT(ARGUMENT *a, ASNSET *before);
-
+void defasnBODY(STATEMENT *s);
+int defasnLOCAL(STATEMENT *s, int n);
+void defasnSTATEMENT(STATEMENT *s, ASNSET *a);
+void defasnCOND(EXP *e, ASNSET *a, ASNSET *f);
+void defasnEXP(EXP *e, ASNSET *a);
+void defasnRECEIVER(RECEIVER *r, ASNSET *a);
+void defasnARGUMENT(ARGUMENT *a, ASNSET *set);
@@ -11,13 +11,13 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "memory.h"
 #include "emit.h"
-
-FILE *emitFILE;
-
-LABEL *emitlabels;
+#include "code.h"
+#include "cfg.h"
+#include "parallel.h"
 
 char *emitname(char *name)
 { int i,j;
@@ -31,468 +31,348 @@ char *emitname(char *name)
   return e;
 }
 
-void emitLABEL(int label)
-{ fprintf(emitFILE,"%s_%i",emitlabels[label].name,label);
+void emitflush(EMITCONTEXT *e)
+{ fwrite(e->buffer,1,e->used,e->file);
+  e->used = 0;
 }
 
-void localmem(char *opcode, int offset)
-{ if (offset >=0 && offset <=3) {
-     fprintf(emitFILE,"%s_%i",opcode,offset);
-  } else {
-     fprintf(emitFILE,"%s %i",opcode,offset);
+void emitstr(EMITCONTEXT *e, char *s)
+{ while (*s!='\0') {
+    if (e->used==EMITBUFSIZE) emitflush(e);
+    e->buffer[e->used++] = *s++;
   }
 }
 
-int argSize(char *sig)
-{ int i,a;
-  i = a = 0;
-  while (sig[i]!='(') i++;
-  i++;
-  while (sig[i]!=')') {
-    a++;
-    if (sig[i]=='L') {
-       while (sig[i]!=';') i++;
-    }
-    i++;
-  }
-  return a;
+void emitint(EMITCONTEXT *e, int i)
+{ char digits[16];
+  int n;
+  unsigned int u;
+  n = sizeof(digits)-1;
+  digits[n] = '\0';
+  u = i<0 ? -(unsigned int)i : (unsigned int)i;
+  do {
+    digits[--n] = '0'+u%10;
+    u /= 10;
+  } while (u!=0);
+  if (i<0) digits[--n] = '-';
+  emitstr(e,digits+n);
 }
 
-int resSize(char *sig)
-{ return sig[strlen(sig)-1]!='V';
+void emitLABEL(EMITCONTEXT *e, int label)
+{ emitstr(e,e->labels[label].name);
+  emitstr(e,"_");
+  emitint(e,label);
 }
 
-int stacklimit;
-
-int setStack(int s)
-{ if (s>stacklimit) stacklimit = s;
-  return s;
+void localmem(EMITCONTEXT *e, char *opcode, int offset)
+{ emitstr(e,opcode);
+  emitstr(e,offset >=0 && offset <=3 ? "_" : " ");
+  emitint(e,offset);
 }
 
-void simCODE(CODE *c, int baseheight)
-{ if (c!=NULL && !c->visited) {
-     c->visited = 1;
-     switch(c->kind) {
-       case nopCK:
-            baseheight = setStack(baseheight);
-            break;
-       case i2cCK:
-            baseheight = setStack(baseheight);
-            break;
-       case newCK:
-            baseheight = setStack(baseheight+1);
-            break;
-       case instanceofCK:
-            baseheight = setStack(baseheight);
-            break;
-       case checkcastCK:
-            baseheight = setStack(baseheight);
-            break;
-       case imulCK:
-            baseheight = setStack(baseheight-1);
-            break;
-       case inegCK:
-            baseheight = setStack(baseheight);
-            break;
-       case iremCK:
-            baseheight = setStack(baseheight-1);
-            break;
-       case isubCK:
-            baseheight = setStack(baseheight-1);
-            break;
-       case idivCK:
-            baseheight = setStack(baseheight-1);
-            break;
-       case iaddCK:
-            baseheight = setStack(baseheight-1);
-            break;
-       case iincCK:
-            baseheight = setStack(baseheight);
-            break;
-       case labelCK:
-            baseheight = setStack(baseheight);
-            break;
-       case gotoCK:
-            baseheight = setStack(baseheight);
-            simCODE(emitlabels[c->val.gotoC].position,baseheight);
-            break;
-       case ifeqCK:
-            baseheight = setStack(baseheight-1);
-            simCODE(emitlabels[c->val.ifeqC].position,baseheight);
-            break;
-       case ifneCK:
-            baseheight = setStack(baseheight-1);
-            simCODE(emitlabels[c->val.ifneC].position,baseheight);
-            break;
-       case if_acmpeqCK:
-            baseheight = setStack(baseheight-2);
-            simCODE(emitlabels[c->val.if_acmpeqC].position,baseheight);
-            break;
-       case if_acmpneCK:
-            baseheight = setStack(baseheight-2);
-            simCODE(emitlabels[c->val.if_acmpneC].position,baseheight);
-            break;
-       case ifnullCK:
-            baseheight = setStack(baseheight-1);
-            simCODE(emitlabels[c->val.ifnullC].position,baseheight);
-            break;
-       case ifnonnullCK:
-            baseheight = setStack(baseheight-1);
-            simCODE(emitlabels[c->val.ifnonnullC].position,baseheight);
-            break;
-       case if_icmpeqCK:
-            baseheight = setStack(baseheight-2);
-            simCODE(emitlabels[c->val.if_icmpeqC].position,baseheight);
-            break;
-       case if_icmpgtCK:
-            baseheight = setStack(baseheight-2);
-            simCODE(emitlabels[c->val.if_icmpgtC].position,baseheight);
-            break;
-       case if_icmpltCK:
-            baseheight = setStack(baseheight-2);
-            simCODE(emitlabels[c->val.if_icmpltC].position,baseheight);
-            break;
-       case if_icmpleCK:
-            baseheight = setStack(baseheight-2);
-            simCODE(emitlabels[c->val.if_icmpleC].position,baseheight);
-            break;
-       case if_icmpgeCK:
-            baseheight = setStack(baseheight-2);
-            simCODE(emitlabels[c->val.if_icmpgeC].position,baseheight);
-            break;
-       case if_icmpneCK:
-            baseheight = setStack(baseheight-2);
-            simCODE(emitlabels[c->val.if_icmpneC].position,baseheight);
-            break;
-       case ireturnCK:
-            baseheight = setStack(baseheight-1);
-            return;
-       case areturnCK:
-            baseheight = setStack(baseheight-1);
-            return;
-       case returnCK:
-            baseheight = setStack(baseheight);
-            return;
-       case aloadCK:
-            baseheight = setStack(baseheight+1);
-            break;
-       case astoreCK:
-            baseheight = setStack(baseheight-1);
-            break;
-       case iloadCK:
-            baseheight = setStack(baseheight+1);
-            break;
-       case istoreCK:
-            baseheight = setStack(baseheight-1);
-            break;
-       case dupCK:
-            baseheight = setStack(baseheight+1);
-            break;
-       case popCK:
-            baseheight = setStack(baseheight-1);
-            break;
-       case swapCK:
-            baseheight = setStack(baseheight);
-            break;
-       case ldc_intCK:
-            baseheight = setStack(baseheight+1);
-            break;
-       case ldc_stringCK:
-            baseheight = setStack(baseheight+1);
-            break;
-       case aconst_nullCK:
-            baseheight = setStack(baseheight+1);
-            break;
-       case getfieldCK:
-            baseheight = setStack(baseheight);
-            break;
-       case putfieldCK:
-            baseheight = setStack(baseheight-2);
-            break;
-       case invokevirtualCK:
-            baseheight = setStack(baseheight-1-argSize(c->val.invokevirtualC)
-                                                  +resSize(c->val.invokevirtualC));
-            break;
-       case invokenonvirtualCK:
-            baseheight = setStack(baseheight-1-argSize(c->val.invokenonvirtualC)
-                                                  +resSize(c->val.invokenonvirtualC));
-            break;
-     }
-     simCODE(c->next,baseheight);
-  }
+/* computes the maximum stack height of the code c, whose labels are
+ * numbered below labels
+ */
+int limitCODE(CODE *c, int labels)
+{ CFG *g;
+  int limit;
+  if (c==NULL) return 0;
+  g = makeCFG(c,labels);
+  limit = limitCFG(g);
+  freeCFG(g);
+  return limit;
 }
 
-int limitCODE(CODE *c)
-{ stacklimit = 0;
-  simCODE(c,0);
-  return stacklimit;
-}
+/* the mnemonic of each kind of instruction */
+char *emitopcode[] = {
+  "nop","i2c",
+  "new","instanceof","checkcast",
+  "imul","ineg","irem","isub","idiv","iadd","iinc",
+  "label","goto","ifeq","ifne","if_acmpeq","if_acmpne",
+  "ifnull","ifnonnull",
+  "if_icmpeq","if_icmpgt","if_icmplt",
+  "if_icmple","if_icmpge","if_icmpne",
+  "ireturn","areturn","return",
+  "aload","astore","iload","istore","dup","pop","swap",
+  "ldc","ldc","aconst_null",
+  "getfield","putfield","invokevirtual","invokenonvirtual"
+};
 
-void emitCODE(CODE *c)
-{ if (c!=NULL) {
-     fprintf(emitFILE,"  ");
+void emitCODE(EMITCONTEXT *e, CODE *c)
+{ for (; c!=NULL; c=c->next) {
+     emitstr(e,"  ");
      switch(c->kind) {
-       case nopCK:
-            fprintf(emitFILE,"nop");
-            break;
-       case i2cCK:
-            fprintf(emitFILE,"i2c");
-            break;
        case newCK:
-            fprintf(emitFILE,"new %s",c->val.newC);
+            emitstr(e,"new ");
+            emitstr(e,c->val.newC);
             break;
        case instanceofCK:
-            fprintf(emitFILE,"instanceof %s",c->val.instanceofC);
+            emitstr(e,"instanceof ");
+            emitstr(e,c->val.instanceofC);
             break;
        case checkcastCK:
-            fprintf(emitFILE,"checkcast %s",c->val.checkcastC);
-            break;
-       case imulCK:
-            fprintf(emitFILE,"imul");
-            break;
-       case inegCK:
-            fprintf(emitFILE,"ineg");
-            break;
-       case iremCK:
-            fprintf(emitFILE,"irem");
-            break;
-       case isubCK:
-            fprintf(emitFILE,"isub");
-            break;
-       case idivCK:
-            fprintf(emitFILE,"idiv");
-            break;
-       case iaddCK:
-            fprintf(emitFILE,"iadd");
+            emitstr(e,"checkcast ");
+            emitstr(e,c->val.checkcastC);
             break;
        case iincCK:
-            fprintf(emitFILE,"iinc %i %i",
-                             c->val.iincC.offset,c->val.iincC.amount);
+            emitstr(e,"iinc ");
+            emitint(e,c->val.iincC.offset);
+            emitstr(e," ");
+            emitint(e,c->val.iincC.amount);
             break;
        case labelCK:
-            emitLABEL(c->val.labelC);
-            fprintf(emitFILE,":");
+            emitLABEL(e,c->val.labelC);
+            emitstr(e,":");
             break;
        case gotoCK:
-            fprintf(emitFILE,"goto ");
-            emitLABEL(c->val.gotoC);
+            emitstr(e,"goto ");
+            emitLABEL(e,c->val.gotoC);
             break;
        case ifeqCK:
-            fprintf(emitFILE,"ifeq ");
-            emitLABEL(c->val.ifeqC);
+            emitstr(e,"ifeq ");
+            emitLABEL(e,c->val.ifeqC);
             break;
        case ifneCK:
-            fprintf(emitFILE,"ifne ");
-            emitLABEL(c->val.ifneC);
+            emitstr(e,"ifne ");
+            emitLABEL(e,c->val.ifneC);
             break;
        case if_acmpeqCK:
-            fprintf(emitFILE,"if_acmpeq ");
-            emitLABEL(c->val.if_acmpeqC);
+            emitstr(e,"if_acmpeq ");
+            emitLABEL(e,c->val.if_acmpeqC);
             break;
        case if_acmpneCK:
-            fprintf(emitFILE,"if_acmpne ");
-            emitLABEL(c->val.if_acmpneC);
+            emitstr(e,"if_acmpne ");
+            emitLABEL(e,c->val.if_acmpneC);
             break;
        case ifnullCK:
-            fprintf(emitFILE,"ifnull ");
-            emitLABEL(c->val.ifnullC);
+            emitstr(e,"ifnull ");
+            emitLABEL(e,c->val.ifnullC);
             break;
        case ifnonnullCK:
-            fprintf(emitFILE,"ifnonnull ");
-            emitLABEL(c->val.ifnonnullC);
+            emitstr(e,"ifnonnull ");
+            emitLABEL(e,c->val.ifnonnullC);
             break;
        case if_icmpeqCK:
-            fprintf(emitFILE,"if_icmpeq ");
-            emitLABEL(c->val.if_icmpeqC);
+            emitstr(e,"if_icmpeq ");
+            emitLABEL(e,c->val.if_icmpeqC);
             break;
        case if_icmpgtCK:
-            fprintf(emitFILE,"if_icmpgt ");
-            emitLABEL(c->val.if_icmpgtC);
+            emitstr(e,"if_icmpgt ");
+            emitLABEL(e,c->val.if_icmpgtC);
             break;
        case if_icmpltCK:
-            fprintf(emitFILE,"if_icmplt ");
-            emitLABEL(c->val.if_icmpltC);
+            emitstr(e,"if_icmplt ");
+            emitLABEL(e,c->val.if_icmpltC);
             break;
        case if_icmpleCK:
-            fprintf(emitFILE,"if_icmple ");
-            emitLABEL(c->val.if_icmpleC);
+            emitstr(e,"if_icmple ");
+            emitLABEL(e,c->val.if_icmpleC);
             break;
        case if_icmpgeCK:
-            fprintf(emitFILE,"if_icmpge ");
-            emitLABEL(c->val.if_icmpgeC);
+            emitstr(e,"if_icmpge ");
+            emitLABEL(e,c->val.if_icmpgeC);
             break;
        case if_icmpneCK:
-            fprintf(emitFILE,"if_icmpne ");
-            emitLABEL(c->val.if_icmpneC);
-            break;
-       case ireturnCK:
-            fprintf(emitFILE,"ireturn");
-            break;
-       case areturnCK:
-            fprintf(emitFILE,"areturn");
-            break;
-       case returnCK:
-            fprintf(emitFILE,"return");
+            emitstr(e,"if_icmpne ");
+            emitLABEL(e,c->val.if_icmpneC);
             break;
        case aloadCK:
-            localmem("aload",c->val.aloadC);
+            localmem(e,"aload",c->val.aloadC);
             break;
        case astoreCK:
-            localmem("astore",c->val.astoreC);
+            localmem(e,"astore",c->val.astoreC);
             break;
        case iloadCK:
-            localmem("iload",c->val.iloadC);
+            localmem(e,"iload",c->val.iloadC);
             break;
        case istoreCK:
-            localmem("istore",c->val.istoreC);
-            break;
-       case dupCK:
-            fprintf(emitFILE,"dup");
-            break;
-       case popCK:
-            fprintf(emitFILE,"pop");
-            break;
-       case swapCK:
-            fprintf(emitFILE,"swap");
+            localmem(e,"istore",c->val.istoreC);
             break;
        case ldc_intCK:
             if (c->val.ldc_intC >= 0 && c->val.ldc_intC <= 5) {
-               fprintf(emitFILE,"iconst_%i",c->val.ldc_intC);
+               emitstr(e,"iconst_");
             } else {
-               fprintf(emitFILE,"ldc %i",c->val.ldc_intC);
+               emitstr(e,"ldc ");
             }
+            emitint(e,c->val.ldc_intC);
             break;
        case ldc_stringCK:
-            fprintf(emitFILE,"ldc \"%s\"",c->val.ldc_stringC);
-            break;
-       case aconst_nullCK:
-            fprintf(emitFILE,"aconst_null");
+            emitstr(e,"ldc \"");
+            emitstr(e,c->val.ldc_stringC);
+            emitstr(e,"\"");
             break;
        case getfieldCK:
-            fprintf(emitFILE,"getfield %s",c->val.getfieldC);
+            emitstr(e,"getfield ");
+            emitstr(e,c->val.getfieldC);
             break;
        case putfieldCK:
-            fprintf(emitFILE,"putfield %s",c->val.putfieldC);
+            emitstr(e,"putfield ");
+            emitstr(e,c->val.putfieldC);
             break;
        case invokevirtualCK:
-            fprintf(emitFILE,"invokevirtual %s",c->val.invokevirtualC);
+            emitstr(e,"invokevirtual ");
+            emitstr(e,c->val.invokevirtualC);
             break;
        case invokenonvirtualCK:
-            fprintf(emitFILE,"invokenonvirtual %s",c->val.invokenonvirtualC);
+            emitstr(e,"invokenonvirtual ");
+            emitstr(e,c->val.invokenonvirtualC);
+            break;
+       default:
+            emitstr(e,emitopcode[c->kind]);
             break;
      }
-     fprintf(emitFILE,"\n");
-     emitCODE(c->next);
+     emitstr(e,"\n");
   }
 }
 
+/* Every source file is written to its .j file as a job of its own.  The
+ * classes of one file go to the same .j file, so they stay in one job and
+ * are written in the order they always were.
+ */
+PROGRAM **emitjobs;
+
+void emitJOB(int i)
+{ EMITCONTEXT *e;
+  e = (EMITCONTEXT *)Malloc(sizeof(EMITCONTEXT));
+  e->labels = NULL;
+  e->used = 0;
+  emitCLASSFILE(e,emitjobs[i]->classfile,emitjobs[i]->name);
+  free(e);
+}
+
 void emitPROGRAM(PROGRAM *p)
-{ if (p!=NULL) {
-     emitPROGRAM(p->next);
-     emitCLASSFILE(p->classfile,p->name);
-  } 
+{ PROGRAM *q;
+  int n,i;
+  n = 0;
+  for (q=p; q!=NULL; q=q->next) n++;
+  emitjobs = (PROGRAM **)Malloc((n+1)*sizeof(PROGRAM *));
+  /* the list holds the files in reverse, and they were written last first */
+  for (q=p, i=n-1; q!=NULL; q=q->next, i--) emitjobs[i] = q;
+  parallel(n,emitJOB);
+  free(emitjobs);
 }
 
-void emitCLASSFILE(CLASSFILE *c, char *name)
+void emitCLASSFILE(EMITCONTEXT *e, CLASSFILE *c, char *name)
 { if (c!=NULL) {
-     emitCLASSFILE(c->next,name);
-     emitCLASS(c->class,name);
+     emitCLASSFILE(e,c->next,name);
+     emitCLASS(e,c->class,name);
   }
 }
 
-void emitCLASS(CLASS *c, char *name)
-{ if (!c->external) {
-     emitFILE = fopen(emitname(name),"w");
-     fprintf(emitFILE,".class public ");
-     emitMODIFIER(c->modifier);
-     fprintf(emitFILE,"%s\n\n",c->name);
-     fprintf(emitFILE,".super %s\n\n",c->parent->signature);
-     emitFIELD(c->fields);
-     if (c->fields!=NULL) fprintf(emitFILE,"\n");
-     emitCONSTRUCTOR(c->constructors);
-     emitMETHOD(c->methods);
-     fclose(emitFILE);
+void emitCLASS(EMITCONTEXT *e, CLASS *c, char *name)
+{ char *filename;
+  if (!c->external) {
+     filename = emitname(name);
+     e->file = fopen(filename,"w");
+     free(filename);
+     emitstr(e,".class public ");
+     emitMODIFIER(e,c->modifier);
+     emitstr(e,c->name);
+     emitstr(e,"\n\n.super ");
+     emitstr(e,c->parent->signature);
+     emitstr(e,"\n\n");
+     emitFIELD(e,c->fields);
+     if (c->fields!=NULL) emitstr(e,"\n");
+     emitCONSTRUCTOR(e,c->constructors);
+     emitMETHOD(e,c->methods);
+     emitflush(e);
+     fclose(e->file);
   }
 }
 
-void emitTYPE(TYPE *t)
+void emitTYPE(EMITCONTEXT *e, TYPE *t)
 { switch (t->kind) {
     case intK:
-         fprintf(emitFILE,"I");
+         emitstr(e,"I");
          break;
     case boolK:
-         fprintf(emitFILE,"Z");
+         emitstr(e,"Z");
          break;
     case charK:
-         fprintf(emitFILE,"C");
+         emitstr(e,"C");
          break;
     case voidK:
-         fprintf(emitFILE,"V");
+         emitstr(e,"V");
          break;
     case refK:
-         fprintf(emitFILE,"L%s;",t->class->signature);
+         emitstr(e,"L");
+         emitstr(e,t->class->signature);
+         emitstr(e,";");
          break;
     case polynullK:
          break;
   }
 }
 
-void emitFIELD(FIELD *f)
+void emitFIELD(EMITCONTEXT *e, FIELD *f)
 { if (f!=NULL) {
-     emitFIELD(f->next);
-     fprintf(emitFILE,".field protected %s ",f->name);
-     emitTYPE(f->type);
-     fprintf(emitFILE,"\n");
+     emitFIELD(e,f->next);
+     emitstr(e,".field protected ");
+     emitstr(e,f->name);
+     emitstr(e," ");
+     emitTYPE(e,f->type);
+     emitstr(e,"\n");
   }
 }
 
-void emitCONSTRUCTOR(CONSTRUCTOR *c)
+void emitCONSTRUCTOR(EMITCONTEXT *e, CONSTRUCTOR *c)
 { if (c!=NULL) {
-     emitCONSTRUCTOR(c->next);
-     fprintf(emitFILE,".method public <init>%s\n",c->signature);
-     fprintf(emitFILE,"  .limit locals %i\n",c->localslimit);
-     emitlabels = c->labels;
-     fprintf(emitFILE,"  .limit stack %i\n",limitCODE(c->opcodes));
-     emitCODE(c->opcodes);
-     fprintf(emitFILE,".end method\n\n");
+     emitCONSTRUCTOR(e,c->next);
+     emitstr(e,".method public <init>");
+     emitstr(e,c->signature);
+     emitstr(e,"\n  .limit locals ");
+     emitint(e,c->localslimit);
+     emitstr(e,"\n");
+     e->labels = c->labels;
+     emitstr(e,"  .limit stack ");
+     emitint(e,limitCODE(c->opcodes,c->labelcount));
+     emitstr(e,"\n");
+     emitCODE(e,c->opcodes);
+     emitstr(e,".end method\n\n");
   }
 }
 
-void emitMETHOD(METHOD *m)
+void emitMETHOD(EMITCONTEXT *e, METHOD *m)
 { if (m!=NULL) {
-     emitMETHOD(m->next);
+     emitMETHOD(e,m->next);
      if (m->modifier==staticMod) {
-        fprintf(emitFILE,".method public static main([Ljava/lang/String;)V\n");
+        emitstr(e,".method public static main([Ljava/lang/String;)V\n");
      } else {
-        fprintf(emitFILE,".method public ");
-        emitMODIFIER(m->modifier);
-        fprintf(emitFILE,"%s%s\n",m->name,m->signature);
+        emitstr(e,".method public ");
+        emitMODIFIER(e,m->modifier);
+        emitstr(e,m->name);
+        emitstr(e,m->signature);
+        emitstr(e,"\n");
      }
       if (m->modifier!=abstractMod) {
-         fprintf(emitFILE,"  .limit locals %i\n",m->localslimit);
-    	 emitlabels = m->labels;
-     	 fprintf(emitFILE,"  .limit stack %i\n",limitCODE(m->opcodes));
-     	 emitCODE(m->opcodes);
+         emitstr(e,"  .limit locals ");
+         emitint(e,m->localslimit);
+         emitstr(e,"\n");
+    	 e->labels = m->labels;
+     	 emitstr(e,"  .limit stack ");
+     	 emitint(e,limitCODE(m->opcodes,m->labelcount));
+     	 emitstr(e,"\n");
+     	 emitCODE(e,m->opcodes);
        }
-     fprintf(emitFILE,".end method\n\n");
+     emitstr(e,".end method\n\n");
   }
 }
 
-void emitMODIFIER(ModifierKind modifier)
+void emitMODIFIER(EMITCONTEXT *e, ModifierKind modifier)
 { switch (modifier)
     { case noneMod:          
            break;
       case finalMod:         
-           fprintf(emitFILE,"final "); 
+           emitstr(e,"final ");
            break;
       case abstractMod:      
-           fprintf(emitFILE,"abstract "); 
+           emitstr(e,"abstract ");
            break;
       case synchronizedMod:  
-           fprintf(emitFILE,"synchronized "); 
+           emitstr(e,"synchronized ");
            break;
       case staticMod:  
-           fprintf(emitFILE,"static "); 
+           emitstr(e,"static "); 
            break;
     }
 }
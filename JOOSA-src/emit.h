@@ -10,14 +10,29 @@
  * email: hendren@cs.mcgill.ca, mis@brics.dk
  */
 
+#include <stdio.h>
 #include "tree.h"
  
-void emitPROGRAM(PROGRAM *p);
-void emitCLASSFILE(CLASSFILE *c, char *name);
-void emitCLASS(CLASS *c, char *name);
-void emitTYPE(TYPE *t);
-void emitFIELD(FIELD *f);
-void emitCONSTRUCTOR(CONSTRUCTOR *c);
-void emitMETHOD(METHOD *m);
-void emitMODIFIER(ModifierKind modifier);
+/* Output goes through the buffer and is written out in large blocks, so
+ * no instruction costs a call to the formatted stdio routines.  Each file
+ * is written with an EMITCONTEXT of its own, so files can be written in
+ * parallel.
+ */
+#define EMITBUFSIZE 8192
 
+typedef struct EMITCONTEXT {
+   FILE *file;
+   LABEL *labels;           /* the labels table of the current method */
+   char buffer[EMITBUFSIZE];
+   int used;
+} EMITCONTEXT;
+
+void emitPROGRAM(PROGRAM *p);
+void emitCLASSFILE(EMITCONTEXT *e, CLASSFILE *c, char *name);
+void emitCLASS(EMITCONTEXT *e, CLASS *c, char *name);
+void emitTYPE(EMITCONTEXT *e, TYPE *t);
+void emitFIELD(EMITCONTEXT *e, FIELD *f);
+void emitCONSTRUCTOR(EMITCONTEXT *e, CONSTRUCTOR *c);
+void emitMETHOD(EMITCONTEXT *e, METHOD *m);
+void emitMODIFIER(EMITCONTEXT *e, ModifierKind modifier);
+int limitCODE(CODE *c, int labels);
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include "memory.h"
 #include "tree.h"
 
 extern CLASSFILE *theclassfile;
@@ -228,7 +229,7 @@ method : tPUBLIC methodmods returntype tIDENTIFIER '(' formals ')' '{' statement
        | tPUBLIC tABSTRACT returntype tIDENTIFIER '(' formals ')' ';'
          {$$ = makeMETHOD($4,abstractMod,$3,$6,NULL,NULL);}
        | tPUBLIC tSTATIC tVOID tMAIN '(' mainargv ')' '{' statements '}'
-         {$$ = makeMETHOD("main",staticMod,makeTYPEvoid(),NULL,$9,NULL);}
+         {$$ = makeMETHOD(intern("main"),staticMod,makeTYPEvoid(),NULL,$9,NULL);}
 ;
 
 methodmods : tFINAL
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include "memory.h"
 #include "tree.h"
 #include "error.h"
 #include "weed.h"
@@ -24,6 +25,9 @@
 #include "code.h"
 #include "optimize.h"
 #include "emit.h"
+#include "bytecode.h"
+#include "snapshot.h"
+#include "server.h"
 
 void yyparse();
 
@@ -33,29 +37,103 @@ PROGRAM *theprogram;
 CLASSFILE *theclassfile;
 
 int optionO;
+int optionClass; /* write .class files instead of Jasmin */
+char *optionSnapshot; /* file caching the parsed .joos files */
 
-int main(int argc, char **argv)
+PROGRAM *preloaded; /* the extern programs a compile server keeps */
+unsigned preloadedhash;
+
+void readFile(char *name)
+{ currentfile = name;
+  if (freopen(currentfile,"r",stdin) != NULL)
+    { lineno = 1;
+      yyparse();
+      theprogram = makePROGRAM(currentfile,theclassfile,theprogram);
+    }
+  else {
+    reportStrGlobalError("Unable to open file %s ",currentfile);
+  }
+}
+
+/* picks up -snapshot and returns the hash of the .joos files */
+unsigned scanArguments(int argc, char **argv, int *externfiles)
 { int i;
+  unsigned hash;
+  optionSnapshot = NULL;
+  *externfiles = 0;
+  hash = 0;
+  for (i=1; i<argc; i++) {
+      if (strcmp(argv[i],"-snapshot")==0 && i+1<argc) {
+         optionSnapshot = argv[++i];
+      } else if (isExternFile(argv[i])) {
+         hash = hashExternFile(argv[i],hash);
+         (*externfiles)++;
+      }
+  }
+  return hash;
+}
+
+/* reads the .joos files among the arguments once, for a compile server */
+void preloadExterns(int argc, char **argv)
+{ int i,externfiles;
+  unsigned hash;
+  hash = scanArguments(argc,argv,&externfiles);
+  theprogram = NULL;
+  if (optionSnapshot!=NULL && externfiles>0) {
+     theprogram = loadSnapshot(optionSnapshot,hash);
+  }
+  if (theprogram==NULL) {
+     for (i=1; i<argc; i++) {
+         if (strcmp(argv[i],"-snapshot")==0 && i+1<argc) i++;
+         else if (isExternFile(argv[i])) readFile(argv[i]);
+     }
+     noErrors();
+  }
+  preloaded = theprogram;
+  preloadedhash = hash;
+  theprogram = NULL;
+}
+
+int compile(int argc, char **argv)
+{ int i,externfiles,loaded;
+  unsigned hash;
+  PROGRAM *externs,*p;
   theprogram = NULL;
   optionO = 0;
+  optionClass = 0;
+  hash = scanArguments(argc,argv,&externfiles);
+  externs = NULL;
+  if (externfiles>0 && preloaded!=NULL && hash==preloadedhash) {
+     externs = preloaded;
+  } else if (optionSnapshot!=NULL && externfiles>0) {
+     externs = loadSnapshot(optionSnapshot,hash);
+  }
+  loaded = externs!=NULL;
   for (i=1; i<argc; i++) {
       if (strcmp(argv[i],"-O")==0) {
          optionO = 1;
-      } else {
-         currentfile = argv[i];
-         if (freopen(currentfile,"r",stdin) != NULL)
-           { lineno = 1;
-             yyparse();
-             theprogram = makePROGRAM(currentfile,theclassfile,theprogram);
-           }
-         else {
-           reportStrGlobalError("Unable to open file %s ",currentfile);
+      } else if (strcmp(argv[i],"-class")==0) {
+         optionClass = 1;
+      } else if (strcmp(argv[i],"-snapshot")==0 && i+1<argc) {
+         i++;
+      } else if (loaded && isExternFile(argv[i])) {
+         /* the loaded externs stand in for all .joos files at the first */
+         if (externs!=NULL) {
+            for (p = externs; p->next!=NULL; p = p->next);
+            p->next = theprogram;
+            theprogram = externs;
+            externs = NULL;
          }
+      } else {
+         readFile(argv[i]);
       }
   }
   noErrors();
   weedPROGRAM(theprogram);
   noErrors();
+  if (optionSnapshot!=NULL && externfiles>0 && !loaded) {
+     saveSnapshot(optionSnapshot,hash,theprogram);
+  }
   symPROGRAM(theprogram);
   noErrors();
   typePROGRAM(theprogram);
@@ -65,6 +143,36 @@ int main(int argc, char **argv)
   resPROGRAM(theprogram);
   codePROGRAM(theprogram);
   if (optionO) optiPROGRAM(theprogram);
-  emitPROGRAM(theprogram);
+  if (optionClass) {
+     bytePROGRAM(theprogram);
+     noErrors();
+  } else {
+     emitPROGRAM(theprogram);
+  }
+  releaseArena(ASTarena);
+  releaseArena(SYMarena);
+  releaseArena(CODEarena);
+  releaseArena(IRarena);
+  releaseNames();
   return 0;
 }
+
+/* joos -server <socket> [-snapshot <file>] <.joos files> runs a compile
+ * server, and joos -client <socket> <arguments> hands a compile to it,
+ * compiling locally if no server answers.
+ */
+int main(int argc, char **argv)
+{ int status;
+  preloaded = NULL;
+  if (argc>2 && strcmp(argv[1],"-server")==0) {
+     preloadExterns(argc-2,argv+2);
+     return serveJOOS(argv[2]);
+  }
+  if (argc>2 && strcmp(argv[1],"-client")==0) {
+     status = clientJOOS(argv[2],argc-3,argv+3);
+     if (status>=0) return status;
+     argc -= 2;
+     argv += 2;
+  }
+  return compile(argc,argv);
+}
@@ -10,8 +10,17 @@
  * email: hendren@cs.mcgill.ca, mis@brics.dk
  */
 
+/* threads are POSIX, not ANSI */
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+
+#ifdef THREADS
+#include <pthread.h>
+#endif
 
 void *Malloc(unsigned n)
 { void *p;
@@ -23,3 +32,164 @@ void *Malloc(unsigned n)
    }
    return p;
 }
+
+
+/* An arena hands out memory by bumping a pointer through large blocks and
+ * gives it all back at once.  Released blocks are kept for the next
+ * compilation instead of being returned to malloc.
+ */
+#define ARENABLOCKSIZE 65536
+
+typedef union ALIGN {
+   long l;
+   double d;
+   void *p;
+} ALIGN;
+
+typedef struct ARENABLOCK {
+   struct ARENABLOCK *next;
+   unsigned size;
+   ALIGN align; /* makes the memory after the header suitably aligned */
+} ARENABLOCK;
+
+typedef struct ARENA {
+   ARENABLOCK *blocks;  /* in use, most recent first */
+   char *next;
+   char *limit;
+} ARENA;
+
+ARENA arenas[ARENAS];
+ARENABLOCK *freeblocks;
+
+#ifdef THREADS
+pthread_mutex_t arenalock = PTHREAD_MUTEX_INITIALIZER;
+int arenalocking;
+#endif
+
+void *allocateIn(int arena, unsigned n);
+
+/* only while threads share the arenas is every allocation locked */
+void lockArenas(int on)
+{
+#ifdef THREADS
+  arenalocking = on;
+#endif
+}
+
+void *Allocate(int arena, unsigned n)
+{ void *r;
+#ifdef THREADS
+  if (arenalocking) {
+     pthread_mutex_lock(&arenalock);
+     r = allocateIn(arena,n);
+     pthread_mutex_unlock(&arenalock);
+     return r;
+  }
+#endif
+  r = allocateIn(arena,n);
+  return r;
+}
+
+void *allocateIn(int arena, unsigned n)
+{ ARENA *a;
+  ARENABLOCK *b,**p;
+  char *r;
+  a = &arenas[arena];
+  n = (n+sizeof(ALIGN)-1)/sizeof(ALIGN)*sizeof(ALIGN);
+  if (a->next==NULL || n > (unsigned)(a->limit-a->next)) {
+     for (p=&freeblocks; *p!=NULL && (*p)->size<n; p=&(*p)->next);
+     if (*p!=NULL) {
+        b = *p;
+        *p = b->next;
+     } else {
+        b = (ARENABLOCK *)Malloc(sizeof(ARENABLOCK)+
+                                 (n>ARENABLOCKSIZE ? n : ARENABLOCKSIZE));
+        b->size = n>ARENABLOCKSIZE ? n : ARENABLOCKSIZE;
+     }
+     b->next = a->blocks;
+     a->blocks = b;
+     a->next = (char *)(b+1);
+     a->limit = a->next+b->size;
+  }
+  r = a->next;
+  a->next += n;
+  return r;
+}
+
+void releaseArena(int arena)
+{ ARENA *a;
+  ARENABLOCK *b;
+  a = &arenas[arena];
+  while ((b = a->blocks)!=NULL) {
+    a->blocks = b->next;
+    b->next = freeblocks;
+    freeblocks = b;
+  }
+  a->next = a->limit = NULL;
+}
+
+
+/* Names, descriptors and string constants are interned, so equal strings
+ * are the same pointer and can be compared with ==.  The table doubles
+ * when it gets full.
+ */
+typedef struct NAME {
+   char *text;
+   unsigned hash;
+   struct NAME *next;
+} NAME;
+
+NAME **names;
+unsigned namessize, namescount;
+
+unsigned namehash(char *s)
+{ unsigned h;
+  h = 0;
+  while (*s) h = 31*h + (unsigned char)*s++;
+  return h;
+}
+
+void growNames()
+{ NAME **old,*n,*next;
+  unsigned oldsize,i;
+  old = names;
+  oldsize = namessize;
+  namessize = namessize==0 ? 1024 : 2*namessize;
+  names = (NAME **)Malloc(namessize*sizeof(NAME *));
+  for (i=0; i<namessize; i++) names[i] = NULL;
+  for (i=0; i<oldsize; i++) {
+      for (n=old[i]; n!=NULL; n=next) {
+          next = n->next;
+          n->next = names[n->hash % namessize];
+          names[n->hash % namessize] = n;
+      }
+  }
+  if (old!=NULL) free(old);
+}
+
+char *intern(char *s)
+{ NAME *n;
+  unsigned h;
+  h = namehash(s);
+  if (namessize>0) {
+     for (n=names[h % namessize]; n!=NULL; n=n->next) {
+         if (n->hash==h && strcmp(n->text,s)==0) return n->text;
+     }
+  }
+  if (namescount>=namessize) growNames();
+  n = NEWIN(NAMEarena,NAME);
+  n->text = (char *)Allocate(NAMEarena,strlen(s)+1);
+  strcpy(n->text,s);
+  n->hash = h;
+  n->next = names[h % namessize];
+  names[h % namessize] = n;
+  namescount++;
+  return n->text;
+}
+
+void releaseNames()
+{ unsigned i;
+  for (i=0; i<namessize; i++) names[i] = NULL;
+  namescount = 0;
+  releaseArena(NAMEarena);
+}
@@ -10,6 +10,25 @@
  * email: hendren@cs.mcgill.ca, mis@brics.dk
  */
 
+/* POSIX threads are used where there are any, unless NOTHREADS is set */
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(NOTHREADS)
+#define THREADS
+#endif
+
 #define NEW(type) (type *)Malloc(sizeof(type))
+#define NEWIN(arena,type) (type *)Allocate(arena,sizeof(type))
+
+/* arenas, each released as a whole once the program is compiled */
+#define ASTarena  0   /* the tree and its analyses */
+#define SYMarena  1   /* symbol tables */
+#define CODEarena 2   /* CODE nodes, kept next to each other */
+#define IRarena   3   /* everything else made by code generation */
+#define NAMEarena 4   /* interned strings */
+#define ARENAS    5
 
 void *Malloc(unsigned n);
+void *Allocate(int arena, unsigned n);
+void releaseArena(int arena);
+void lockArenas(int on);
+char *intern(char *s);
+void releaseNames();
@@ -11,9 +11,14 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include "memory.h"
 #include "optimize.h"
+#include "cfg.h"
+#include "parallel.h"
 
 /*****  isA  functions,  return true if the instruction pointed to by
  *****  the parameter c is an instruction of the given kind.
@@ -441,31 +446,189 @@ int uses_label(CODE *c, int *label)
          is_if_icmpge(c,label) || is_if_icmpne(c,label);
 }
 
-LABEL *currentlabels;   /* points to current labels table */
-LABEL **currentlabelstable; /* pointer to field in AST
-			       pointing to labels table */
-int currentlabelstablesize;
-int _label; /* current offset of last used label */
+/* The state of the method being optimized.  Methods are optimized in
+ * parallel, so the helpers find it through the thread they run on.
+ */
+typedef struct OPTCONTEXT {
+   LABEL *labels;           /* the labels table of the method */
+   LABEL **labelstable;     /* the field of the method pointing to it */
+   int labelstablesize;
+   int label;               /* last label in use */
+   LABELUSE *freeuses;      /* entries dropped from the index, for reuse */
+   CODE **code;             /* the code of the method */
+   CFG *cfg;
+   int cfgvalid;            /* whether cfg matches the code */
+   int locals;              /* number of local slots */
+   int livewords;           /* number of words in a live set */
+   int livevalid;           /* whether the live sets can be trusted */
+   unsigned *livepool;      /* storage for the live sets */
+   int livepoolsize, livepoolused;
+   unsigned *liveempty;     /* the live set after the last instruction */
+   unsigned *livetemp;      /* scratch set for queries */
+   CODE **work;             /* positions still to try the patterns at */
+   int worksize, workused;
+   int change;              /* whether the last round rewrote anything */
+   int *frequencies;        /* firings of each pattern in this method */
+   int skipped;
+} OPTCONTEXT;
+
+#define CONTEXT ((OPTCONTEXT *)parallelLocal())
+
+
+/******  Worklist of the driver.  An instruction is queued when the
+ ******  patterns starting at it may match differently from the last time
+ ******  they were tried there.  replace and the label counts queue what a
+ ******  rewrite can affect, so the driver never walks the whole method to
+ ******  find the few places worth another look.  ******/
+
+/* Number of instructions the longest pattern looks at.  A pattern starting
+ * up to this many positions minus one in front of a rewrite may now match.
+ */
+#define MAX_PATTERN_LENGTH 4
+
+#define QUEUED  1
+#define DROPPED 2   /* taken out of the code by replace */
+
+/* queues c, unless it is queued already or no longer in the code */
+void requeue(CODE *c)
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  if (c==NULL || c->queued!=0) return;
+  if (o->workused==o->worksize) {
+     o->worksize = o->worksize==0 ? 256 : 2*o->worksize;
+     o->work = (CODE **)realloc(o->work,o->worksize*sizeof(CODE *));
+     if (o->work==NULL) {
+        fprintf(stderr,"realloc of optimizer worklist failed.\n");
+        abort();
+     }
+  }
+  o->work[o->workused++] = c;
+  c->queued = QUEUED;
+}
+
+/* queues the patterns that ask how label is used: those at or just in
+ * front of it, which ask whether it is dead, and the one left branching to
+ * it, which may ask whether it is the only one.
+ */
+void requeueuses(int label)
+{ OPTCONTEXT *o;
+  LABELUSE *u;
+  CODE *d;
+  o = CONTEXT;
+  u = o->labels[label].uses;
+  if (u!=NULL && u->next==NULL) requeue(u->branch);
+  d = o->labels[label].position;
+  if (d!=NULL && d->queued!=DROPPED) {
+     requeue(d);
+     requeue(d->prev);
+  }
+}
+
+/* queues the branches to label, whose patterns follow it through
+ * destination() into the code after it
+ */
+void requeuebranches(int label)
+{ OPTCONTEXT *o;
+  LABELUSE *u;
+  o = CONTEXT;
+  for (u=o->labels[label].uses; u!=NULL; u=u->next) requeue(u->branch);
+}
+
+/* links every instruction of the method back to the one in front of it,
+ * with nothing queued yet
+ */
+void initwork(CODE *c)
+{ OPTCONTEXT *o;
+  CODE *prev;
+  o = CONTEXT;
+  o->workused = 0;
+  prev = NULL;
+  for (; c!=NULL; c=c->next) {
+      c->prev = prev;
+      c->queued = 0;
+      prev = c;
+  }
+}
+
+/* queues every instruction, so that the first is tried first */
+void queuecode(CODE *c)
+{ OPTCONTEXT *o;
+  CODE *t;
+  int i,n;
+  o = CONTEXT;
+  n = o->workused;
+  for (; c!=NULL; c=c->next) requeue(c);
+  for (i=n; i<n+(o->workused-n)/2; i++) {
+      t = o->work[i];
+      o->work[i] = o->work[o->workused-1-(i-n)];
+      o->work[o->workused-1-(i-n)] = t;
+  }
+}
+
+/* called by replace once the k instructions from old on, linked from *c,
+ * have been replaced by the code from *c up to p.  It links the new code
+ * back and queues it, with p and the instructions in front of it in the
+ * order the driver should visit them, the first on top.
+ */
+void workreplace(CODE **c, CODE *old, int k, CODE *p)
+{ OPTCONTEXT *o;
+  CODE *owner,*q,*t;
+  int i,n,label;
+  o = CONTEXT;
+  for (i=0; i<k; i++, old=old->next) old->queued = DROPPED;
+  owner = c==o->code ? NULL : (CODE *)((char *)c-offsetof(CODE,next));
+  requeue(p);
+  n = o->workused;
+  for (q=owner, t=*c; t!=p; q=t, t=t->next) {
+      t->prev = q;
+      requeue(t);
+  }
+  if (p!=NULL) p->prev = q;
+  for (i=n; i<n+(o->workused-n)/2; i++) {
+      t = o->work[i];
+      o->work[i] = o->work[o->workused-1-(i-n)];
+      o->work[o->workused-1-(i-n)] = t;
+  }
+  /* labels just in front are followed into the rewrite by destination() */
+  for (q=owner, i=1; q!=NULL && i<MAX_PATTERN_LENGTH; q=q->prev, i++) {
+      if (is_label(q,&label)) requeuebranches(label);
+  }
+  for (q=owner, i=1; q!=NULL && i<MAX_PATTERN_LENGTH; q=q->prev, i++) {
+      requeue(q);
+  }
+}
 
 CODE *destination(int label)
-{ return currentlabels[label].position;
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  return o->labels[label].position;
 }
 
 int copylabel(int label)
-{ currentlabels[label].sources++;
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  o->labels[label].sources++;
+  requeueuses(label);
   return label;
 }
 
 void droplabel(int label)
-{ currentlabels[label].sources--;
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  o->labels[label].sources--;
+  requeueuses(label);
 }
 
 int deadlabel(int label)
-{ return currentlabels[label].sources==0;
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  return o->labels[label].sources==0;
 }
 
 int uniquelabel(int label)
-{ return currentlabels[label].sources==1;
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  return o->labels[label].sources==1;
 }
 
 /* returns next available index into label table.  If the table is full
@@ -473,30 +636,460 @@ int uniquelabel(int label)
  * and then fixing the pointer from the AST to this new table.
  */
 int next_label()
-{ int i;
+{ OPTCONTEXT *o;
+  int i;
+  o = CONTEXT;
 
-  _label++;
-  if (_label==currentlabelstablesize)
+  o->label++;
+  if (o->label==o->labelstablesize)
     { /* allocate new table, double the size */
-      currentlabels=Malloc(currentlabelstablesize*2*sizeof(LABEL));
+      o->labels=Allocate(IRarena,o->labelstablesize*2*sizeof(LABEL));
       /* copy entries to new table */
-      for (i=0;i<currentlabelstablesize;i++)
-        currentlabels[i]=(*currentlabelstable)[i];
-      currentlabelstablesize*=2;
+      for (i=0;i<o->labelstablesize;i++)
+        o->labels[i]=(*o->labelstable)[i];
+      o->labelstablesize*=2;
       /* fixup pointer in AST to new table */
-      *currentlabelstable=currentlabels;
+      *o->labelstable=o->labels;
     }
-  return(_label);
+  return(o->label);
 }
 
 
 /* inserts a new entry in label table */
 void INSERTnewlabel(int i,char* name,CODE *target,int count)
-{ currentlabels[i].name = name;
-  currentlabels[i].position = target;
-  currentlabels[i].sources = count;
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  o->labels[i].name = name;
+  o->labels[i].position = target;
+  o->labels[i].sources = count;
+  o->labels[i].uses = NULL;
+}
+
+
+/******  Index from each label to the branches that jump to it.  It is
+ ******  built once per method and kept up to date by replace, so
+ ******  patterns never need to walk the method to find them.  ******/
+
+/* returns the branch instructions that jump to label */
+LABELUSE *label_uses(int label)
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  return o->labels[label].uses;
+}
+
+void addlabeluse(CODE *c)
+{ OPTCONTEXT *o;
+  int label;
+  LABELUSE *u;
+  o = CONTEXT;
+  if (!uses_label(c,&label)) return;
+  if (o->freeuses!=NULL) {
+     u = o->freeuses;
+     o->freeuses = u->next;
+  } else {
+     u = NEWIN(IRarena,LABELUSE);
+  }
+  requeueuses(label);
+  u->branch = c;
+  u->next = o->labels[label].uses;
+  o->labels[label].uses = u;
+}
+
+void droplabeluse(CODE *c)
+{ OPTCONTEXT *o;
+  int label;
+  LABELUSE **u,*d;
+  o = CONTEXT;
+  if (!uses_label(c,&label)) return;
+  for (u = &o->labels[label].uses; *u!=NULL; u = &((*u)->next)) {
+      if ((*u)->branch==c) {
+         d = *u;
+         *u = d->next;
+         d->next = o->freeuses;
+         o->freeuses = d;
+         requeueuses(label);
+         return;
+      }
+  }
+}
+
+/* also sets the sources of every label to the number of branches to it,
+ * since the code generator may give a label more than one
+ */
+void initlabeluses(CODE *c)
+{ OPTCONTEXT *o;
+  int i,label;
+  o = CONTEXT;
+  for (i=0; i<o->labelstablesize; i++) {
+      o->labels[i].uses = NULL;
+      o->labels[i].sources = 0;
+  }
+  for (; c!=NULL; c=c->next) {
+      addlabeluse(c);
+      if (uses_label(c,&label)) o->labels[label].sources++;
+  }
+}
+
+
+/******  Control-flow graph of the current method.  It is built the first
+ ******  time it is asked for and dropped by replace whenever a rewrite
+ ******  adds or removes a jump, a label or a return.  ******/
+
+int is_return_kind(CODE *c)
+{ return is_return(c) || is_ireturn(c) || is_areturn(c);
+}
+
+/* may c change the control flow, or be the target of a jump? */
+int is_flow(CODE *c)
+{ int label;
+  return uses_label(c,&label) || is_label(c,&label) || is_return_kind(c);
 }
 
+/* returns the graph of the current method, rebuilding it if needed */
+CFG *method_cfg()
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  if (!o->cfgvalid) {
+     if (o->cfg!=NULL) freeCFG(o->cfg);
+     o->cfg = makeCFG(*o->code,o->label+1);
+     o->cfgvalid = 1;
+  }
+  return o->cfg;
+}
+
+void initcfg(CODE **opcodes)
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  o->code = opcodes;
+  o->cfgvalid = 0;
+}
+
+/* is c the first or last instruction of a block of the current graph? */
+int is_block_end(CODE *c)
+{ OPTCONTEXT *o;
+  BLOCK *b;
+  o = CONTEXT;
+  if (c==NULL || c->block<0 || c->block>=o->cfg->size) return 0;
+  b = &o->cfg->blocks[c->block];
+  return b->first==c || b->last==c;
+}
+
+/* called by replace once the k instructions from old on have been replaced
+ * by r, which runs up to p.  Removing the first or last instruction of a
+ * block, or inserting in front of a block or at the end of the code, also
+ * drops the graph.  Otherwise the new instructions join the block they
+ * were put in.
+ */
+void cfgreplace(CODE *old, int k, CODE *r, CODE *p)
+{ OPTCONTEXT *o;
+  CODE *q;
+  int i,block;
+  o = CONTEXT;
+  if (!o->cfgvalid) return;
+  if (k==0 && r!=p && (p==NULL || is_block_end(p))) o->cfgvalid = 0;
+  block = k>0 ? old->block : p!=NULL ? p->block : -1;
+  for (i=0; i<k; i++, old=old->next) {
+      if (is_flow(old) || is_block_end(old)) o->cfgvalid = 0;
+  }
+  for (q=r; q!=p; q=q->next) {
+      if (is_flow(q)) o->cfgvalid = 0;
+  }
+  if (!o->cfgvalid) return;
+  for (q=r; q!=p; q=q->next) q->block = block;
+}
+
+
+/******  Liveness of local variables.  The live set of an instruction
+ ******  holds the locals that may be read from there on before being
+ ******  overwritten.  The sets of a method are computed the first time
+ ******  they are asked for, and replace keeps them up to date for rewrites
+ ******  that do not change the control flow.  ******/
+
+#define LIVEBITS (8*sizeof(unsigned))
+
+unsigned *newliveset()
+{ OPTCONTEXT *o;
+  unsigned *l;
+  int i;
+  o = CONTEXT;
+  if (o->livepoolused+o->livewords > o->livepoolsize) {
+     o->livepoolsize = 2*o->livepoolsize+64*o->livewords;
+     o->livepool = (unsigned *)Allocate(IRarena,o->livepoolsize*sizeof(unsigned));
+     o->livepoolused = 0;
+  }
+  l = &o->livepool[o->livepoolused];
+  o->livepoolused += o->livewords;
+  for (i=0; i<o->livewords; i++) l[i] = 0;
+  return l;
+}
+
+/* unions into out the live sets of the instructions c can continue with,
+ * returns 0 if one of them has no live set yet.
+ */
+int liveafter(CODE *c, unsigned *out)
+{ OPTCONTEXT *o;
+  int i,label;
+  unsigned *in;
+  o = CONTEXT;
+  for (i=0; i<o->livewords; i++) out[i] = 0;
+  if (is_return_kind(c)) return 1;
+  if (!is_goto(c,&label)) {
+     in = c->next==NULL ? o->liveempty : c->next->live;
+     if (in==NULL) return 0;
+     for (i=0; i<o->livewords; i++) out[i] |= in[i];
+  }
+  if (uses_label(c,&label)) {
+     in = destination(label)->live;
+     if (in==NULL) return 0;
+     for (i=0; i<o->livewords; i++) out[i] |= in[i];
+  }
+  return 1;
+}
+
+/* turns the locals live after c into those live before it */
+void livetransfer(CODE *c, unsigned *l)
+{ int x,amount;
+  if (is_istore(c,&x) || is_astore(c,&x)) {
+     l[x/LIVEBITS] &= ~(1u << (x%LIVEBITS));
+  } else if (is_iload(c,&x) || is_aload(c,&x) || is_iinc(c,&x,&amount)) {
+     l[x/LIVEBITS] |= 1u << (x%LIVEBITS);
+  }
+}
+
+/* backward dataflow over the blocks of the method, iterated to a fixed
+ * point.  Only the set at the start of a block is read by other blocks,
+ * so a pass that leaves all of those unchanged is the last one.
+ */
+void computeliveness()
+{ OPTCONTEXT *o;
+  CFG *g;
+  BLOCK *b;
+  CODE *c;
+  CODE **order;
+  int n,i,j,k,change;
+  o = CONTEXT;
+  g = method_cfg();
+  n = 0;
+  for (c=*o->code; c!=NULL; c=c->next) n++;
+  if (o->livepoolsize < (n+2)*o->livewords) {
+     o->livepoolsize = 2*(n+2)*o->livewords;
+     o->livepool = (unsigned *)Allocate(IRarena,o->livepoolsize*sizeof(unsigned));
+  }
+  o->livepoolused = 0;
+  o->liveempty = newliveset();
+  o->livetemp = newliveset();
+  order = (CODE **)Malloc((n+1)*sizeof(CODE *));
+  n = 0;
+  for (c=*o->code; c!=NULL; c=c->next) {
+      c->live = newliveset();
+      order[n++] = c;
+  }
+  change = 1;
+  while (change) {
+    change = 0;
+    i = n;
+    for (k=g->size-1; k>=0; k--) {
+        b = &g->blocks[k];
+        (void)liveafter(b->last,o->livetemp);
+        do {
+          i--;
+          livetransfer(order[i],o->livetemp);
+          for (j=0; j<o->livewords; j++) {
+              if (o->livetemp[j]!=order[i]->live[j]) {
+                 order[i]->live[j] = o->livetemp[j];
+                 if (order[i]==b->first) change = 1;
+              }
+          }
+        } while (order[i]!=b->first);
+    }
+  }
+  free(order);
+  o->livevalid = 1;
+}
+
+/* starts liveness for a method whose locals are numbered 0..locals-1 */
+void initliveness(int locals)
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  o->locals = locals;
+  o->livewords = (locals+LIVEBITS-1)/LIVEBITS;
+  if (o->livewords==0) o->livewords = 1;
+  o->livepoolsize = o->livepoolused = 0;
+  o->livevalid = 0;
+}
+
+/* is local x possibly read after c before being overwritten? */
+int live_after(CODE *c, int x)
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  if (!o->livevalid || c->live==NULL) computeliveness();
+  if (!liveafter(c,o->livetemp)) {
+     computeliveness();
+     (void)liveafter(c,o->livetemp);
+  }
+  return (o->livetemp[x/LIVEBITS] >> (x%LIVEBITS)) & 1;
+}
+
+/* gives the instructions from r up to p their live sets, working back from
+ * the one of p.  Returns 0 if this cannot be done locally.
+ */
+int liveannotate(CODE *r, CODE *p)
+{ if (r==p) return p==NULL || p->live!=NULL;
+  if (is_flow(r) || !liveannotate(r->next,p)) return 0;
+  r->live = newliveset();
+  (void)liveafter(r,r->live);
+  livetransfer(r,r->live);
+  return 1;
+}
+
+/* called by replace once the k instructions from old on have been replaced
+ * by r, which runs up to p (r==p if nothing was put in).  If the control flow may have changed, or the
+ * live set at the start of the window grew, the sets before the window are
+ * no longer safe and everything is recomputed the next time.
+ */
+void livereplace(CODE *old, int k, CODE *r, CODE *p)
+{ OPTCONTEXT *o;
+  CODE *q;
+  int i;
+  o = CONTEXT;
+  if (!o->livevalid) return;
+  for (i=0, q=old; i<k; i++, q=q->next) {
+      if (q->live==NULL || is_flow(q)) {
+         o->livevalid = 0;
+         return;
+      }
+  }
+  if (!liveannotate(r,p)) {
+     o->livevalid = 0;
+     return;
+  }
+  for (i=0; i<o->livewords; i++) {
+      if ((r==NULL ? 0 : r->live[i]) & ~old->live[i]) {
+         o->livevalid = 0;
+         return;
+      }
+  }
+}
+
+/******  Slot coalescing.  Once a method is optimized, its locals are
+ ******  given slots again, so that locals that are never live at the same
+ ******  time share one.  The most used locals go first and take the lowest
+ ******  free slot, so they get the short forms for slots 0 to 3.  ******/
+
+/* returns the local c loads, stores or increments, or -1 */
+int slotof(CODE *c)
+{ int x,amount;
+  if (is_iload(c,&x) || is_aload(c,&x) || is_istore(c,&x) || is_astore(c,&x) ||
+      is_iinc(c,&x,&amount)) return x;
+  return -1;
+}
+
+void setslot(CODE *c, int x)
+{ switch (c->kind) {
+    case iloadCK:
+         c->val.iloadC = x;
+         break;
+    case aloadCK:
+         c->val.aloadC = x;
+         break;
+    case istoreCK:
+         c->val.istoreC = x;
+         break;
+    case astoreCK:
+         c->val.astoreC = x;
+         break;
+    case iincCK:
+         c->val.iincC.offset = x;
+         break;
+    default:
+         break;
+  }
+}
+
+#define INTERFERE(x,y) (interfere[(x)*o->livewords+(y)/LIVEBITS] & (1u << ((y)%LIVEBITS)))
+
+/* marks x as interfering with every local but itself in the set l */
+void interfereset(unsigned *interfere, int x, unsigned *l)
+{ OPTCONTEXT *o;
+  int y;
+  o = CONTEXT;
+  for (y=0; y<o->locals; y++) {
+      if (y!=x && ((l[y/LIVEBITS] >> (y%LIVEBITS)) & 1)) {
+         interfere[x*o->livewords+y/LIVEBITS] |= 1u << (y%LIVEBITS);
+         interfere[y*o->livewords+x/LIVEBITS] |= 1u << (x%LIVEBITS);
+      }
+  }
+}
+
+/* gives new slots to the locals of the current method, whose first params
+ * slots hold this and the formals.  Returns the number of slots used.
+ */
+int coalescelocals(int params)
+{ OPTCONTEXT *o;
+  CODE *c;
+  unsigned *interfere,*entry;
+  int *uses,*slot;
+  int n,x,y,s,best,limit;
+  o = CONTEXT;
+  n = o->locals;
+  if (n==0 || *o->code==NULL) return params;
+  computeliveness();
+  interfere = (unsigned *)Malloc(n*o->livewords*sizeof(unsigned));
+  uses = (int *)Malloc(n*sizeof(int));
+  slot = (int *)Malloc(n*sizeof(int));
+  for (x=0; x<n*o->livewords; x++) interfere[x] = 0;
+  for (x=0; x<n; x++) {
+      uses[x] = 0;
+      slot[x] = -1;
+  }
+
+  /* a local interferes with the locals live where it is written, and the
+   * formals are written on entry
+   */
+  for (c=*o->code; c!=NULL; c=c->next) {
+      x = slotof(c);
+      if (x<0) continue;
+      uses[x]++;
+      if (c->kind!=iloadCK && c->kind!=aloadCK) {
+         (void)liveafter(c,o->livetemp);
+         interfereset(interfere,x,o->livetemp);
+      }
+  }
+  entry = (*o->code)->live;
+  for (x=0; x<n; x++) {
+      if (x<params || ((entry[x/LIVEBITS] >> (x%LIVEBITS)) & 1)) {
+         interfereset(interfere,x,entry);
+         slot[x] = x;
+      }
+  }
+
+  limit = params;
+  for (;;) {
+    best = -1;
+    for (x=0; x<n; x++) {
+        if (slot[x]<0 && uses[x]>0 && (best<0 || uses[x]>uses[best])) best = x;
+    }
+    if (best<0) break;
+    for (s=0; ; s++) {
+        for (y=0; y<n; y++) {
+            if (slot[y]==s && INTERFERE(best,y)) break;
+        }
+        if (y==n) break;
+    }
+    slot[best] = s;
+    if (s+1>limit) limit = s+1;
+  }
+
+  for (c=*o->code; c!=NULL; c=c->next) {
+      x = slotof(c);
+      if (x>=0) setslot(c,slot[x]);
+  }
+  o->livevalid = 0;
+  free(interfere);
+  free(uses);
+  free(slot);
+  return limit;
+}
 
 /***** Helper functions to replace k instructions starting at at c by
        the sequence of Code pointed to by r.   *****/
@@ -509,17 +1102,27 @@ void INSERTnewlabel(int i,char* name,CODE *target,int count)
  * automatically for you)
  */
 int replace(CODE **c, int k, CODE *r)
-{ CODE *p;
+{ CODE *p,*old;
   int i;
-  p = *c;
-  for (i=0; i<k; i++) p=p->next;
+  p = old = *c;
+  for (i=0; i<k; i++) {
+    droplabeluse(p);
+    p=p->next;
+  }
   if (r==NULL) {
      *c = p;
   } else {
      *c = r;
-     while (r->next!=NULL) r=r->next;
+     addlabeluse(r);
+     while (r->next!=NULL) {
+       r=r->next;
+       addlabeluse(r);
+     }
      r->next = p;
   }
+  workreplace(c,old,k,p);
+  cfgreplace(old,k,*c,p);
+  livereplace(old,k,*c,p);
   return 1;
 }
 
@@ -528,13 +1131,14 @@ int replace(CODE **c, int k, CODE *r)
  *  Changes have been made to automatically drop labels if needed.
  */
 int replace_modified(CODE **c, int k, CODE *r)
-{ CODE *p;
+{ CODE *p,*old;
   int i;
-  p = *c;
+  p = old = *c;
  for (i=0; i<k; i++) {
    int label;
    if (uses_label(p, &label) && !deadlabel(label))
      droplabel(label);
+   droplabeluse(p);
    p=p->next;
   }
   if (r==NULL) {
@@ -542,9 +1146,16 @@ int replace_modified(CODE **c, int k, CODE *r)
     }
   else {
     *c = r;
-    while (r->next!=NULL) r=r->next;
+    addlabeluse(r);
+    while (r->next!=NULL) {
+      r=r->next;
+      addlabeluse(r);
+    }
     r->next = p;
   }
+  workreplace(c,old,k,p);
+  cfgreplace(old,k,*c,p);
+  livereplace(old,k,*c,p);
   return 1;
 }
 
@@ -583,151 +1194,432 @@ int kill_line(CODE **c)
  */
 
 int stack_effect(CODE *c, int *inc, int *affected, int *used)
-{
-  char *stringpos;
-  if(c!=NULL) {
-
-  switch(c->kind) {
-    case nopCK:
-	case iincCK:
-      *inc=*used=*affected=0;
-      break;
-
-	case instanceofCK:
-    case getfieldCK:
-    case i2cCK:
-    case inegCK:
-      *inc=0;
-      *used=*affected=-1;
-      break;
-
-    case checkcastCK:
-      *inc = *affected =0;
-      *used= -1;
-      break;
-
-    case swapCK:
-      *inc=0;
-      *used=*affected=-2;
-      break;
-
+{ int label;
+  if (c==NULL) return 0;
+  effectCODE(c,inc,affected,used);
+  switch (c->kind) {
+    case gotoCK:
+         return 1;
     case labelCK:
-      *inc=*used=*affected=0;
-      return 3;
-      break;
-
-    case newCK:
-    case iloadCK:
-    case aloadCK:
-    case ldc_intCK:
-    case ldc_stringCK:
-    case aconst_nullCK:
-      *inc = +1;
-      *affected=*used=0;
-      break;
-
-    case dupCK:
-      *inc=1;
-      *affected=0;
-      *used=-1;
-      break;
-
-    case popCK:
-    case istoreCK:
-    case astoreCK:
-      *inc=*used=*affected= -1;
-      break;
+         return 3;
+    case ireturnCK:
+    case areturnCK:
+    case returnCK:
+         return 4;
+    default:
+         return uses_label(c,&label) ? 2 : 0;
+  }
+}
 
-    case iremCK:
-    case isubCK:
-    case idivCK:
+/******  Constant propagation.  The integer values on the stack and in
+ ******  the locals are followed through the blocks of the method, along
+ ******  the edges that can be taken given what is known.  Loads of known
+ ******  values become constants, arithmetic on constants is folded, and
+ ******  branches that always go the same way become gotos or disappear,
+ ******  together with the code only they reached.  ******/
+
+typedef struct CONSTANT {
+   int known;
+   int value;
+} CONSTANT;
+
+/* the state at the start of a block */
+typedef struct CONSTANTSTATE {
+   int reached;
+   int height;
+   CONSTANT *values;        /* the locals, then the stack */
+} CONSTANTSTATE;
+
+/* arithmetic is done unsigned, so it wraps around as in Java */
+int constantfold(CODE *c, int a, int b, int *result)
+{ switch (c->kind) {
     case iaddCK:
+         *result = (int)((unsigned)a+(unsigned)b);
+         return 1;
+    case isubCK:
+         *result = (int)((unsigned)a-(unsigned)b);
+         return 1;
     case imulCK:
-      *inc=-1;
-      *used=*affected=-2;
-      break;
-
-    case putfieldCK:
-      *used=*affected=*inc = -2;
-      break;
-
-    case invokevirtualCK:
-    case invokenonvirtualCK:
-      *inc=-1; /* receiver */
-      if(c->kind==invokevirtualCK)
-        stringpos = c->val.invokevirtualC;
-      else
-        stringpos = c->val.invokenonvirtualC;
-
-      while((*stringpos) != '(') stringpos++;
-      stringpos++;
-
-      /* one for each formal */
-      while((*stringpos) != ')') {
-        (*inc)--;
-        if((*stringpos)=='L')
-          while((*stringpos)!=';') stringpos++;
-        stringpos++;
-      }
-      stringpos++;
-
-      *used = *affected = *inc;
-
-      /* if not void, then pushes return value */
-      if((*stringpos)!='V')
-        (*inc)++;
-      break;
+         *result = (int)((unsigned)a*(unsigned)b);
+         return 1;
+    case idivCK:
+         if (b==0) return 0;
+         *result = b==-1 ? (int)(0u-(unsigned)a) : a/b;
+         return 1;
+    case iremCK:
+         if (b==0) return 0;
+         *result = b==-1 ? 0 : a%b;
+         return 1;
+    case inegCK:
+         *result = (int)(0u-(unsigned)b);
+         return 1;
+    case i2cCK:
+         *result = b & 0xffff;
+         return 1;
+    default:
+         return 0;
+  }
+}
 
+/* returns 1 if the branch c is always taken, 0 if never and -1 if it
+ * depends, given the stack of the given height in front of it
+ */
+int constantbranch(CODE *c, CONSTANT *stack, int height)
+{ CONSTANT *a,*b;
+  switch (c->kind) {
     case gotoCK:
-      *used = *affected = *inc =0;
-      return 1;
-      break;
-
+         return 1;
     case ifeqCK:
     case ifneCK:
-    case ifnullCK:
-    case ifnonnullCK:
-      *inc = *used = *affected = -1;
-      return 2;
-      break;
-
+         a = &stack[height-1];
+         if (!a->known) return -1;
+         return (c->kind==ifeqCK) == (a->value==0);
     case if_icmpeqCK:
     case if_icmpneCK:
-    case if_icmpgtCK:
     case if_icmpltCK:
     case if_icmpleCK:
+    case if_icmpgtCK:
     case if_icmpgeCK:
-    case if_acmpeqCK:
-    case if_acmpneCK:
-      *inc = *used = *affected = -2;
-      return 2;
-      break;
-
-    case returnCK:
-      *inc = *used = *affected = 0;
-      return 4;
-    case areturnCK:
-    case ireturnCK:
-      *inc = *used = *affected = -1;
-      return 4;
-      break;
+         a = &stack[height-2];
+         b = &stack[height-1];
+         if (!a->known || !b->known) return -1;
+         switch (c->kind) {
+           case if_icmpeqCK:
+                return a->value==b->value;
+           case if_icmpneCK:
+                return a->value!=b->value;
+           case if_icmpltCK:
+                return a->value<b->value;
+           case if_icmpleCK:
+                return a->value<=b->value;
+           case if_icmpgtCK:
+                return a->value>b->value;
+           default:
+                return a->value>=b->value;
+         }
+    default:
+         return -1;
+  }
+}
 
+/* moves the locals and the stack of the given height past c */
+void constanttransfer(CODE *c, CONSTANT *locals, CONSTANT *stack, int *height)
+{ CONSTANT t;
+  int inc,affected,used,i,x,amount,k;
+  switch (c->kind) {
+    case ldc_intCK:
+         stack[*height].known = 1;
+         stack[*height].value = c->val.ldc_intC;
+         (*height)++;
+         return;
+    case iloadCK:
+         stack[(*height)++] = locals[c->val.iloadC];
+         return;
+    case istoreCK:
+         locals[c->val.istoreC] = stack[--(*height)];
+         return;
+    case astoreCK:
+         locals[c->val.astoreC].known = 0;
+         (*height)--;
+         return;
+    case iincCK:
+         x = c->val.iincC.offset;
+         amount = c->val.iincC.amount;
+         if (locals[x].known) {
+            locals[x].value = (int)((unsigned)locals[x].value+(unsigned)amount);
+         }
+         return;
+    case dupCK:
+         stack[*height] = stack[*height-1];
+         (*height)++;
+         return;
+    case swapCK:
+         t = stack[*height-1];
+         stack[*height-1] = stack[*height-2];
+         stack[*height-2] = t;
+         return;
+    case iaddCK:
+    case isubCK:
+    case imulCK:
+    case idivCK:
+    case iremCK:
+         (*height)--;
+         t.known = stack[*height-1].known && stack[*height].known &&
+                   constantfold(c,stack[*height-1].value,stack[*height].value,&k);
+         t.value = t.known ? k : 0;
+         stack[*height-1] = t;
+         return;
+    case inegCK:
+    case i2cCK:
+         t.known = stack[*height-1].known &&
+                   constantfold(c,0,stack[*height-1].value,&k);
+         t.value = t.known ? k : 0;
+         stack[*height-1] = t;
+         return;
     default:
-      printf("Stack_Effect: unrecognized code kind\n");
-      *inc=*used=*affected=0;
-      break;
+         /* anything else only pops, and pushes what is not known */
+         (void)stack_effect(c,&inc,&affected,&used);
+         *height += affected;
+         for (i=0; i<inc-affected; i++) stack[(*height)++].known = 0;
+         return;
+  }
+}
+
+/* merges the state after a block into the start of its successor b,
+ * returns 1 if that changed it
+ */
+int constantmerge(CONSTANTSTATE *b, CONSTANT *values, int height, int width)
+{ int i,change;
+  if (!b->reached) {
+     b->reached = 1;
+     b->height = height;
+     for (i=0; i<width; i++) b->values[i] = values[i];
+     return 1;
+  }
+  change = 0;
+  for (i=0; i<width; i++) {
+      if (b->values[i].known &&
+          (!values[i].known || values[i].value!=b->values[i].value)) {
+         b->values[i].known = 0;
+         change = 1;
+      }
+  }
+  return change;
+}
+
+/* is c a constant to the stack? */
+int is_constant(CODE *c)
+{ int k;
+  return is_ldc_int(c,&k);
+}
+
+/* rewrites the method using what is known at the start of each block,
+ * returns 1 if anything was rewritten.  *cut is set if a known branch
+ * lost one of its edges.
+ */
+int constantrewrite(CFG *g, CONSTANTSTATE *states, CONSTANT *values,
+                    CODE ***window, int width, int *cut)
+{ OPTCONTEXT *o;
+  CODE **p;
+  CODE *c,*r;
+  CONSTANT *locals,*stack;
+  int height,n,i,rewrote,taken,operands,label;
+  o = CONTEXT;
+  locals = values;
+  stack = values+o->locals;
+  rewrote = 0;
+  n = 0;
+  height = 0;
+  p = o->code;
+  while (*p!=NULL) {
+    c = *p;
+    if (c->block>=0 && g->blocks[c->block].first==c) {
+       /* the code of unreached blocks is left alone until it is removed */
+       if (!states[c->block].reached) {
+          while (*p!=NULL && (*p)->block==c->block) p = &((*p)->next);
+          continue;
+       }
+       for (i=0; i<width; i++) values[i] = states[c->block].values[i];
+       height = states[c->block].height;
+       n = 0;
+    }
+    r = NULL;
+    operands = 0;
+    switch (c->kind) {
+      case iloadCK:
+           if (locals[c->val.iloadC].known) {
+              r = makeCODEldc_int(locals[c->val.iloadC].value,NULL);
+           }
+           break;
+      case iaddCK:
+      case isubCK:
+      case imulCK:
+      case idivCK:
+      case iremCK:
+           operands = 2;
+           break;
+      case inegCK:
+      case i2cCK:
+           operands = 1;
+           break;
+      default:
+           break;
     }
+    if (operands>0) {
+       /* fold only where the operands are constants just in front */
+       for (i=1; i<=operands; i++) {
+           if (n<i || !is_constant(*window[n-i])) operands = 0;
+       }
+    }
+    if (uses_label(c,&label) && c->kind!=gotoCK &&
+        (taken = constantbranch(c,stack,height))!=-1) {
+       operands = c->kind==ifeqCK || c->kind==ifneCK ? 1 : 2;
+       for (i=1; i<=operands; i++) {
+           if (n<i || !is_constant(*window[n-i])) break;
+       }
+       if (i<=operands) {
+          /* the operands come from further away, so pop them instead */
+          r = taken ? makeCODEgoto(label,NULL) : NULL;
+          for (i=0; i<operands; i++) r = makeCODEpop(r);
+          if (taken) {
+             replace(p,1,r);
+          } else {
+             replace_modified(p,1,r);
+          }
+          operands = 0;
+       } else {
+          n -= operands;
+          p = window[n];
+          if (taken) {
+             replace(p,operands+1,makeCODEgoto(label,NULL));
+          } else {
+             replace_modified(p,operands+1,NULL);
+          }
+       }
+       rewrote = 1;
+       *cut = 1;
+       constanttransfer(c,locals,stack,&height);
+       /* the branch ended the block, so move on to the next one */
+       while (*p!=NULL && (*p)->block<0) p = &((*p)->next);
+       continue;
+    }
+    constanttransfer(c,locals,stack,&height);
+    if (operands>0 && stack[height-1].known) {
+       n -= operands;
+       p = window[n];
+       replace(p,operands+1,makeCODEldc_int(stack[height-1].value,NULL));
+       rewrote = 1;
+    } else if (r!=NULL) {
+       replace(p,1,r);
+       rewrote = 1;
+    }
+    window[n++] = p;
+    p = &((*p)->next);
   }
-  return 0;
+  return rewrote;
+}
+
+/* deletes the code of the blocks of g that constant propagation did not
+ * reach, returns 1 if there was any.  The known branches have just been
+ * rewritten, so these are the blocks nothing reaches any more.  Code the
+ * rewrite added has no block, but it only ever goes into blocks that were
+ * reached.  Dead code after a goto or return is otherwise left to
+ * remove_unreachable_code; this is for what a folded branch cuts off,
+ * which may be a whole loop that only jumps to itself.
+ */
+int sweepunreachable(CFG *g, CONSTANTSTATE *states)
+{ OPTCONTEXT *o;
+  CODE **p;
+  int swept;
+  o = CONTEXT;
+  swept = 0;
+  p = o->code;
+  while (*p!=NULL) {
+    if ((*p)->block>=0 && !states[(*p)->block].reached) {
+       replace_modified(p,1,NULL);
+       swept = 1;
+    } else {
+       p = &((*p)->next);
+    }
+  }
+  return swept;
+}
+
+/* runs constant propagation over the current method, returns 1 if it
+ * changed the code
+ */
+int propagateconstants()
+{ OPTCONTEXT *o;
+  CFG *g;
+  BLOCK *b;
+  CODE *c;
+  CODE ***window;
+  CONSTANTSTATE *states;
+  CONSTANT *values,*locals,*stack;
+  int *work;
+  int *onwork;
+  int width,i,n,top,height,taken,label,rewrote,cut;
+  o = CONTEXT;
+  if (*o->code==NULL) return 0;
+  g = method_cfg();
+  width = o->locals+limitCFG(g)+1;
+  states = (CONSTANTSTATE *)Malloc(g->size*sizeof(CONSTANTSTATE));
+  values = (CONSTANT *)Malloc((g->size+1)*width*sizeof(CONSTANT));
+  for (i=0; i<g->size; i++) {
+      states[i].reached = 0;
+      states[i].values = values+(i+1)*width;
+  }
+  locals = values;
+  stack = values+o->locals;
+  work = (int *)Malloc(g->size*sizeof(int));
+  onwork = (int *)Malloc(g->size*sizeof(int));
+  for (i=0; i<g->size; i++) onwork[i] = 0;
+
+  /* nothing is known about the locals on entry */
+  for (i=0; i<width; i++) values[i].known = 0;
+  (void)constantmerge(&states[0],values,0,width);
+  top = 0;
+  work[top++] = 0;
+  onwork[0] = 1;
+  while (top>0) {
+    b = &g->blocks[work[--top]];
+    onwork[b->id] = 0;
+    for (i=0; i<width; i++) values[i] = states[b->id].values[i];
+    height = states[b->id].height;
+    taken = -1;
+    for (c=b->first; c!=b->last->next; c=c->next) {
+        if (c==b->last) taken = constantbranch(c,stack,height);
+        constanttransfer(c,locals,stack,&height);
+    }
+    for (i=0; i<b->succsize; i++) {
+        n = b->succ[i]->id;
+        /* a known branch only takes one of its edges */
+        if (taken!=-1 && uses_label(b->last,&label)) {
+           if (taken) n = g->labelblock[label]->id; else n = b->id+1;
+           if (i>0) break;
+        }
+        if (constantmerge(&states[n],values,height,width) && !onwork[n]) {
+           work[top++] = n;
+           onwork[n] = 1;
+        }
+    }
+  }
+
+  n = 0;
+  for (c=*o->code; c!=NULL; c=c->next) n++;
+  window = (CODE ***)Malloc((n+1)*sizeof(CODE **));
+  cut = 0;
+  rewrote = constantrewrite(g,states,values,window,width,&cut);
+  if (cut && sweepunreachable(g,states)) rewrote = 1;
+  free(window);
+  free(work);
+  free(onwork);
+  free(values);
+  free(states);
+  return rewrote;
 }
 
 typedef int(*OPTI)(CODE **);
 
 /*************************  MAIN OPTIMIZATION LOOP **********************/
 
-int add_pattern(char *name, OPTI pattern);
+/* A pattern is added with the kinds of instruction it can start with,
+ * ANYKIND if it may start anywhere.  The list ends with ENDKINDS.
+ */
+#define ANYKIND (-2)
+#define ENDKINDS (-1)
+
+int add_pattern(char *name, OPTI pattern, ...);
 
-#define ADD_PATTERN(x) add_pattern(#x, x)
+#define ADD_PATTERN(x,k) add_pattern(#x, x, k, ENDKINDS)
+#define ADD_PATTERN2(x,k1,k2) add_pattern(#x, x, k1, k2, ENDKINDS)
+#define ADD_PATTERN3(x,k1,k2,k3) add_pattern(#x, x, k1, k2, k3, ENDKINDS)
+#define ADD_PATTERN4(x,k1,k2,k3,k4) \
+        add_pattern(#x, x, k1, k2, k3, k4, ENDKINDS)
+#define ADD_PATTERN5(x,k1,k2,k3,k4,k5) \
+        add_pattern(#x, x, k1, k2, k3, k4, k5, ENDKINDS)
+#define ADD_PATTERN6(x,k1,k2,k3,k4,k5,k6) \
+        add_pattern(#x, x, k1, k2, k3, k4, k5, k6, ENDKINDS)
 
 /* Here is a null_pattern that is usefull as a place holder in your array. */
 int null_pattern(CODE **c)  { return 0; }
@@ -741,56 +1633,211 @@ int null_pattern(CODE **c)  { return 0; }
 #ifndef OPTS
 
 #define MAX_PATTERNS 100
+#define PATTERN_SLOTS MAX_PATTERNS
+#else
+#define PATTERN_SLOTS OPTS
+#endif /* ifndef OPTS */
+
+/* number of CODE kinds, invokenonvirtualCK is the last one in tree.h */
+#define CODE_KINDS (invokenonvirtualCK+1)
+
+/* the kinds of instruction each pattern can start with.  A pattern added
+ * with ANYKIND is not declared and may start anywhere.
+ */
+int declared[PATTERN_SLOTS];
+char leading[PATTERN_SLOTS][CODE_KINDS];
+
+#ifndef OPTS
 
 char *opti_name[MAX_PATTERNS]; /* name of the patterns */
 OPTI optimization[MAX_PATTERNS];
 int frequencies[MAX_PATTERNS];
 int OPTS = 0;
 
-int add_pattern(char *name, OPTI pattern)
+int add_pattern(char *name, OPTI pattern, ...)
 {
-	if (OPTS > MAX_PATTERNS) {
+	va_list kinds;
+	int kind;
+	if (OPTS >= MAX_PATTERNS) {
 		printf ("cannot add any more pattern");
 		return 0;
 	}
 	opti_name[OPTS] = name;
 	optimization[OPTS] = pattern;
+	va_start(kinds, pattern);
+	while ((kind = va_arg(kinds, int)) != ENDKINDS) {
+		if (kind == ANYKIND) {
+			declared[OPTS] = 0;
+			break;
+		}
+		declared[OPTS] = 1;
+		leading[OPTS][kind] = 1;
+	}
+	va_end(kinds);
 	OPTS++;
 	return 1;
 }
+
 #else
 int frequencies[OPTS];
 /* dummy add_pattern, because it should not be used in that case */
-int add_pattern(char *name, OPTI pattern) {return 0;}
+int add_pattern(char *name, OPTI pattern, ...) {return 0;}
 #endif /* ifndef OPTS */
 
+/* dispatch[k] lists, in order, the patterns that can start with an
+ * instruction of kind k.  The extra last row is used at the end of the code.
+ */
+int dispatch[CODE_KINDS+1][PATTERN_SLOTS];
+int dispatchsize[CODE_KINDS+1];
+int skipped; /* pattern invocations avoided by the dispatch table */
+
+#define DISPATCHKIND(c) ((c)==NULL ? CODE_KINDS : (c)->kind)
+
+void init_dispatch(void)
+{ int i,k;
+  for (k=0; k<=CODE_KINDS; k++) {
+    dispatchsize[k] = 0;
+    for (i=0; i<OPTS; i++) {
+      if (!declared[i] || (k<CODE_KINDS && leading[i][k]))
+        dispatch[k][dispatchsize[k]++] = i;
+    }
+  }
+}
 
-int optiCHANGE;
 
-void optiCODEtraverse(CODE **c)
-{ int i,change;
+/* applies all patterns at *c until none of them fires any more,
+ * returns 1 if at least one of them did.
+ */
+int optiCODEposition(OPTCONTEXT *o, CODE **c)
+{ int i,n,kind,calls,change,fired;
+  fired = 0;
   change = 1;
-  if (*c!=NULL) {
-     while (change) {
-       change = 0;
-       for (i=0; i<OPTS; i++) {
-	  int optimized;
-	  optimized = optimization[i](c);
-	  if (optimized) frequencies[i]++;
-          change = change | optimized;
+  while (change) {
+    change = 0;
+    calls = 0;
+    kind = DISPATCHKIND(*c);
+    n = 0;
+    while (n<dispatchsize[kind]) {
+       i = dispatch[kind][n++];
+       calls++;
+       if (optimization[i](c)) {
+          o->frequencies[i]++;
+          change = 1;
+          if (DISPATCHKIND(*c)!=kind) {
+             /* go on with the patterns after i for the new first instruction */
+             kind = DISPATCHKIND(*c);
+             for (n=0; n<dispatchsize[kind] && dispatch[kind][n]<=i; n++);
+          }
        }
-       optiCHANGE = optiCHANGE || change;
-     }
-     if (*c!=NULL) optiCODEtraverse(&((*c)->next));
+    }
+    o->skipped += OPTS-calls;
+    fired = fired || change;
+  }
+  return fired;
+}
+
+/* Tries the patterns at the queued instructions until none is left.  The
+ * position of an instruction is the next field of the one in front of it,
+ * or the head of the code.
+ */
+void optiCODEwork(OPTCONTEXT *o)
+{ CODE *c;
+  while (o->workused>0) {
+    c = o->work[--o->workused];
+    if (c->queued!=QUEUED) continue;
+    c->queued = 0;
+    if (optiCODEposition(o,c->prev==NULL ? o->code : &c->prev->next)) {
+       o->change = 1;
+    }
   }
 }
 
+/* Each round queues the whole method once.  The worklist then follows
+ * every rewrite to where it can make a difference, save through the live
+ * sets, which replace only ever lets shrink on recomputation, and through
+ * chains of labels longer than a pattern.  A round that rewrote anything
+ * is therefore checked by another one, which normally finds nothing.
+ */
 void optiCODE(CODE **c)
-{ optiCHANGE = 1;
-  while (optiCHANGE) {
-    optiCHANGE = 0;
-    optiCODEtraverse(c);
+{ OPTCONTEXT *o;
+  o = CONTEXT;
+  o->change = 1;
+  while (o->change) {
+    o->change = 0;
+    queuecode(*c);
+    optiCODEwork(o);
+    if (!o->change) o->change = propagateconstants();
+  }
+}
+
+/* The constructors and methods to optimize are collected first and then
+ * optimized as independent jobs, each with its own OPTCONTEXT.
+ */
+typedef struct OPTIJOB {
+   CODE **opcodes;
+   LABEL **labels;
+   int *labelcount;
+   int *localslimit;
+   int params;              /* slots of this and the formals */
+   int *frequencies;
+   int skipped;
+} OPTIJOB;
+
+OPTIJOB *optijobs;
+int optijobcount, optijobsize;
+
+void addOptiJob(CODE **opcodes, LABEL **labels, int *labelcount,
+                int *localslimit, int params)
+{ OPTIJOB *j;
+  if (optijobcount==optijobsize) {
+     optijobsize = optijobsize==0 ? 64 : 2*optijobsize;
+     optijobs = (OPTIJOB *)realloc(optijobs,optijobsize*sizeof(OPTIJOB));
+     if (optijobs==NULL) {
+        fprintf(stderr,"realloc of optimizer jobs failed.\n");
+        abort();
+     }
   }
+  j = &optijobs[optijobcount++];
+  j->opcodes = opcodes;
+  j->labels = labels;
+  j->labelcount = labelcount;
+  j->localslimit = localslimit;
+  j->params = params;
+}
+
+void optiJOB(int i)
+{ OPTIJOB *j;
+  OPTCONTEXT o;
+  int k;
+  j = &optijobs[i];
+  o.labels = *j->labels;
+  o.labelstable = j->labels;
+  o.labelstablesize = *j->labelcount;
+  o.label = o.labelstablesize-1;
+  o.freeuses = NULL;
+  o.work = NULL;
+  o.worksize = 0;
+  o.workused = 0;
+  o.cfg = NULL;
+  o.change = 0;
+  o.frequencies = (int *)Malloc((OPTS+1)*sizeof(int));
+  for (k=0; k<OPTS; k++) o.frequencies[k] = 0;
+  o.skipped = 0;
+  setParallelLocal(&o);
+  initlabeluses(*j->opcodes);
+  initwork(*j->opcodes);
+  initcfg(j->opcodes);
+  initliveness(*j->localslimit);
+  optiCODE(j->opcodes);
+  *j->localslimit = coalescelocals(j->params);
+  /* Feng fix */
+  *j->labelcount = o.label+1;
+  if (o.cfg!=NULL) freeCFG(o.cfg);
+  free(o.work);
+  *j->opcodes = compactCODE(*j->opcodes,o.labels);
+  setParallelLocal(NULL);
+  j->frequencies = o.frequencies;
+  j->skipped = o.skipped;
 }
 
 void optiPROGRAMrec(PROGRAM *p)
@@ -802,17 +1849,24 @@ void optiPROGRAMrec(PROGRAM *p)
 
 void optiPROGRAM(PROGRAM *p)
 {
-  int i;
+  int i,j;
   for(i = 0; i < OPTS; i++)
     frequencies[i] = 0;
 
 #ifndef OPTS
   init_patterns();
 #endif
-
-  if (p!=NULL) {
-    optiPROGRAMrec(p->next);
-    optiCLASSFILE(p->classfile);
+  init_dispatch();
+  skipped = 0;
+
+  optijobcount = 0;
+  optiPROGRAMrec(p);
+  parallel(optijobcount,optiJOB);
+  for (j = 0; j < optijobcount; j++) {
+    for (i = 0; i < OPTS; i++)
+      frequencies[i] += optijobs[j].frequencies[i];
+    skipped += optijobs[j].skipped;
+    free(optijobs[j].frequencies);
   }
 
   printf("\nFrequencies:\n");
@@ -824,6 +1878,7 @@ void optiPROGRAM(PROGRAM *p)
 #endif
 
   printf("\n");
+  printf("Skipped pattern invocations: %d\n", skipped);
 }
 
 void optiCLASSFILE(CLASSFILE *c)
@@ -840,28 +1895,23 @@ void optiCLASS(CLASS *c)
   }
 }
 
+int formalslots(FORMAL *f)
+{ if (f==NULL) return 0;
+  return 1+formalslots(f->next);
+}
+
 void optiCONSTRUCTOR(CONSTRUCTOR *c)
 { if (c!=NULL) {
      optiCONSTRUCTOR(c->next);
-     currentlabels = c->labels;
-     currentlabelstable = &(c->labels);
-     currentlabelstablesize = c->labelcount;
-     _label=currentlabelstablesize-1;
-     optiCODE(&c->opcodes);
-     /* Feng fix */
-     c->labelcount=_label+1;
+     addOptiJob(&c->opcodes,&c->labels,&c->labelcount,&c->localslimit,
+                1+formalslots(c->formals));
   }
 }
 
 void optiMETHOD(METHOD *m)
 { if (m!=NULL) {
      optiMETHOD(m->next);
-     currentlabels = m->labels;
-     currentlabelstable = &(m->labels);
-     currentlabelstablesize = m->labelcount;
-     _label=currentlabelstablesize-1;
-     optiCODE(&m->opcodes);
-     /* Feng fix */
-     m->labelcount=_label+1;
+     addOptiJob(&m->opcodes,&m->labels,&m->labelcount,&m->localslimit,
+                1+formalslots(m->formals));
   }
 }
@@ -0,0 +1,111 @@
+/*
+ * JOOS is Copyright (C) 1997 Laurie Hendren & Michael I. Schwartzbach
+ *
+ * Reproduction of all or part of this software is permitted for
+ * educational or research use on condition that this copyright notice is
+ * included in any copy. This software comes with no warranty of any
+ * kind. In no event will the authors be liable for any damages resulting from
+ * use of this software.
+ *
+ * email: hendren@cs.mcgill.ca, mis@brics.dk
+ */
+
+/* threads are POSIX, not ANSI */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "memory.h"
+#include "parallel.h"
+
+#ifdef THREADS
+
+#include <pthread.h>
+#include <unistd.h>
+
+pthread_key_t localkey;
+pthread_once_t localonce = PTHREAD_ONCE_INIT;
+pthread_mutex_t jobslock = PTHREAD_MUTEX_INITIALIZER;
+void (*jobfunction)(int i);
+int nextjob, jobcount;
+
+void makeLocalKey()
+{ pthread_key_create(&localkey,NULL);
+}
+
+int parallelThreads()
+{ long n;
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n<1 ? 1 : (int)n;
+}
+
+void *parallelWorker(void *unused)
+{ int i;
+  for (;;) {
+    pthread_mutex_lock(&jobslock);
+    i = nextjob++;
+    pthread_mutex_unlock(&jobslock);
+    if (i>=jobcount) return NULL;
+    jobfunction(i);
+  }
+}
+
+/* runs job(0) to job(jobs-1), and returns when all are done.  The jobs
+ * may allocate from the arenas, which are locked meanwhile.
+ */
+void parallel(int jobs, void (*job)(int i))
+{ pthread_t *threads;
+  int n,i,created;
+  pthread_once(&localonce,makeLocalKey);
+  n = parallelThreads();
+  if (n>jobs) n = jobs;
+  if (n<=1) {
+     for (i=0; i<jobs; i++) job(i);
+     return;
+  }
+  jobfunction = job;
+  nextjob = 0;
+  jobcount = jobs;
+  lockArenas(1);
+  threads = (pthread_t *)Malloc(n*sizeof(pthread_t));
+  for (created=0; created<n-1; created++) {
+      if (pthread_create(&threads[created],NULL,parallelWorker,NULL)!=0) break;
+  }
+  /* the calling thread takes jobs too */
+  (void)parallelWorker(NULL);
+  for (i=0; i<created; i++) pthread_join(threads[i],NULL);
+  free(threads);
+  lockArenas(0);
+}
+
+void *parallelLocal()
+{ return pthread_getspecific(localkey);
+}
+
+void setParallelLocal(void *p)
+{ pthread_once(&localonce,makeLocalKey);
+  pthread_setspecific(localkey,p);
+}
+
+#else
+
+void *local;
+
+int parallelThreads()
+{ return 1;
+}
+
+void parallel(int jobs, void (*job)(int i))
+{ int i;
+  for (i=0; i<jobs; i++) job(i);
+}
+
+void *parallelLocal()
+{ return local;
+}
+
+void setParallelLocal(void *p)
+{ local = p;
+}
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * JOOS is Copyright (C) 1997 Laurie Hendren & Michael I. Schwartzbach
+ *
+ * Reproduction of all or part of this software is permitted for
+ * educational or research use on condition that this copyright notice is
+ * included in any copy. This software comes with no warranty of any
+ * kind. In no event will the authors be liable for any damages resulting from
+ * use of this software.
+ *
+ * email: hendren@cs.mcgill.ca, mis@brics.dk
+ */
+
+/* Runs jobs on a pool of threads, one per processor, where POSIX threads
+ * are available and one after the other otherwise.  Each thread has one
+ * slot of its own, for the state of the job it is running.
+ */
+
+int parallelThreads();
+void parallel(int jobs, void (*job)(int i));
+void *parallelLocal();
+void setParallelLocal(void *p);
@@ -16,45 +16,30 @@
 
 /*
  * Checks if the given load (returns false if not load) is the last
- * before another store of the same index. If there are any jump
- * operations return false since we cannot conclude they wont jump
- * somewhere that uses a load of the same index
+ * before another store of the same index, on every path leaving it.
+ * This asks the liveness of the method, so branches after the load
+ * no longer make us give up.
  */
 int is_last_value_load(CODE *c) {
-  int loadInd, storeInd, testLoadInd, labelBuf;
-  if (is_aload(c, &loadInd)) {
-    /* a load stuff */
-    CODE *cur = next(c);
-    /* while cur isn't null and isn't an astore with same value */
-    while(cur && !(is_astore(cur, &storeInd) && storeInd == loadInd)) {
-      if (is_aload(cur, &testLoadInd) && testLoadInd == loadInd)
-        return 0;
-      if (uses_label(cur, &labelBuf))
-        return 0;
-      cur = next(cur);
-    }
-    /* If we didn't find a corresponding load then this must be last load */
-    return 1;
-  }
-  else if (is_iload(c, &loadInd)) {
-    /* i load stuff */
-    CODE *cur = next(c);
-    /* while cur isn't null and isn't an astore with same value */
-    while(cur && !(is_istore(cur, &storeInd) && storeInd == loadInd)) {
-      if (is_iload(cur, &testLoadInd) && testLoadInd == loadInd)
-        return 0;
-      if (uses_label(cur, &labelBuf))
-        return 0;
-      cur = next(cur);
-    }
-    /* If we didn't find a corresponding load then this must be last load */
-    return 1;
+  int loadInd;
+  if (is_aload(c, &loadInd) || is_iload(c, &loadInd)) {
+    return !live_after(c, loadInd);
   }
   else {
     return 0;
   }
 }
 
+/*
+ * Checks if c is the only branch to the given label.  This asks the
+ * index of the branches to each label instead of the label's count.
+ */
+int is_only_branch_to(int label, CODE *c) {
+  LABELUSE *u;
+  u = label_uses(label);
+  return u != NULL && u->branch == c && u->next == NULL;
+}
+
 /*
  * PATTERNS
  */
@@ -359,7 +344,7 @@ int remove_superfluous_storeloads(CODE **c)
     return replace(c, 2, NULL);
   }
   else if (is_istore(*c, &storeInd) &&
-      is_iload(next(*c), &storeInd) &&
+      is_iload(next(*c), &loadInd) &&
       storeInd == loadInd &&
       is_last_value_load(next(*c))) {
     return replace(c, 2, NULL);
@@ -515,6 +500,24 @@ int remove_dead_label(CODE **c) {
   return 0;
 }
 
+/* goto L          goto L
+ * x               (or return, ireturn, areturn)
+ * --------->
+ *
+ * where x is not a label that is jumped to.  Nothing can reach x, so it
+ * goes, and the branches in it give up their labels.  Applied again until
+ * the next live label, this deletes the whole unreachable region.
+ */
+int remove_unreachable_code(CODE **c) {
+  int l;
+  if ((is_goto(*c, &l) || is_return_kind(*c)) &&
+      next(*c) != NULL &&
+      (!is_label(next(*c), &l) || deadlabel(l))) {
+    return kill_line(&((*c)->next));
+  }
+  return 0;
+}
+
 /*
  * goto l1
  * ...
@@ -527,7 +530,7 @@ int remove_dead_label(CODE **c) {
  */
 int remove_unnecessary_label(CODE **c) {
     int l1, l2;
-    if (is_goto(*c, &l1) && uniquelabel(l1) && is_label(next(destination(l1)), &l2) && l1 > l2) {
+    if (is_goto(*c, &l1) && is_only_branch_to(l1, *c) && is_label(next(destination(l1)), &l2) && l1 > l2) {
         droplabel(l1);
         copylabel(l2);
         return replace(c, 1, makeCODEgoto(l2, NULL));
@@ -601,10 +604,10 @@ int remove_unnecessary_label_traversal(CODE **c) {
                 replace(c, 1, makeCODEif_icmplt(trueLabel, NULL));
             }
             copylabel(trueLabel);
-            /* if l1 is unique, drop it and drop its following line iconst_1 */
-            if (uniquelabel(l1)) {
+            /* if nothing jumps to l1 any more, drop it and drop its following line iconst_1 */
+            if (label_uses(l1) == NULL) {
                 droplabel(l1);
-                destination(l1)->next = next(destination(l1))->next;
+                replace(&destination(l1)->next, 1, NULL);
             }
             return 1;
         }
@@ -661,7 +664,7 @@ int simplify_end_of_conditional(CODE **c) {
             is_ifeq(next(next(next(destination(l1)))), &l3)) {
         /* make a new label */
         int nextLabel = next_label();
-        CODE* newLabel = makeCODElabel(nextLabel, next(next(next(next(destination(l1))))));
+        CODE* newLabel = makeCODElabel(nextLabel, NULL);
         /* record the label in the labels table */
         INSERTnewlabel(nextLabel, "optlabel", newLabel, 1);
         /* have c point to the new label instead of true_10 */
@@ -679,14 +682,14 @@ int simplify_end_of_conditional(CODE **c) {
             replace(c, 1, makeCODEif_icmplt(nextLabel, NULL));
         }
         /* add the new label after ifeq stop_0 */
-        next(next(next(destination(l1))))->next = newLabel;
+        replace(&next(next(next(destination(l1))))->next, 0, newLabel);
 
         /* other optimizations...
-         * if true_10 is unique, drop it and drop its following line iconst_1
+         * if nothing jumps to true_10 any more, drop it and drop its following line iconst_1
          */
-        if (uniquelabel(l1)) {
+        if (label_uses(l1) == NULL) {
             droplabel(l1);
-            destination(l1)->next = next(destination(l1))->next;
+            replace(&destination(l1)->next, 1, NULL);
         }
         return 1;
     }
@@ -707,31 +710,39 @@ int remove_unnecessary_goto(CODE **c) {
     return 0;
 }
 
+/* Each pattern is given with the kinds of instruction it can start with,
+ * so that the driver only tries it where it can possibly match.
+ */
 void init_patterns(void) {
-  ADD_PATTERN(simplify_multiplication_right);
-  ADD_PATTERN(simplify_multiplication_left);
-  ADD_PATTERN(simplify_addition_right);
-  ADD_PATTERN(simplify_addition_left);
-  ADD_PATTERN(simplify_subtraction_right);
-  ADD_PATTERN(simplify_subtraction_left);
-  ADD_PATTERN(simplify_division_right);
-  ADD_PATTERN(simplify_division_left);
-  ADD_PATTERN(simplify_modulo_right);
-  ADD_PATTERN(simplify_astore);
-  ADD_PATTERN(simplify_istore);
-  ADD_PATTERN(positive_increment);
-  ADD_PATTERN(simplify_goto_goto);
-  ADD_PATTERN(simplify_istore_0_double_branch);
-  ADD_PATTERN(remove_superfluous_storeloads);
-  ADD_PATTERN(remove_pointless_mul_div);
-  ADD_PATTERN(remove_pointless_add_sub);
-  ADD_PATTERN(remove_pointless_sub_add);
-  ADD_PATTERN(remove_dead_label);
-  ADD_PATTERN(remove_self_div);
-  ADD_PATTERN(remove_nop);
-  ADD_PATTERN(remove_unnecessary_label);
-  ADD_PATTERN(simplify_end_of_conditional);
-  ADD_PATTERN(remove_unnecessary_label_traversal); /* must come after simplify_end_of_conditional */
-  ADD_PATTERN(remove_unnecessary_goto);
-  ADD_PATTERN(remove_useless_branch);
+  ADD_PATTERN(simplify_multiplication_right, iloadCK);
+  ADD_PATTERN(simplify_multiplication_left, ldc_intCK);
+  ADD_PATTERN(simplify_addition_right, iloadCK);
+  ADD_PATTERN(simplify_addition_left, ldc_intCK);
+  ADD_PATTERN(simplify_subtraction_right, iloadCK);
+  ADD_PATTERN(simplify_subtraction_left, ldc_intCK);
+  ADD_PATTERN(simplify_division_right, iloadCK);
+  ADD_PATTERN(simplify_division_left, ldc_intCK);
+  ADD_PATTERN(simplify_modulo_right, iloadCK);
+  ADD_PATTERN(simplify_astore, dupCK);
+  ADD_PATTERN(simplify_istore, dupCK);
+  ADD_PATTERN2(positive_increment, iloadCK, ldc_intCK);
+  ADD_PATTERN(simplify_goto_goto, gotoCK);
+  ADD_PATTERN(simplify_istore_0_double_branch, ldc_intCK);
+  ADD_PATTERN2(remove_superfluous_storeloads, astoreCK, istoreCK);
+  ADD_PATTERN(remove_pointless_mul_div, ldc_intCK);
+  ADD_PATTERN(remove_pointless_add_sub, ldc_intCK);
+  ADD_PATTERN(remove_pointless_sub_add, ldc_intCK);
+  ADD_PATTERN2(remove_dead_label, ldc_intCK, labelCK);
+  ADD_PATTERN4(remove_unreachable_code,
+      gotoCK, returnCK, ireturnCK, areturnCK);
+  ADD_PATTERN2(remove_self_div, ldc_intCK, iloadCK);
+  ADD_PATTERN(remove_nop, nopCK);
+  ADD_PATTERN(remove_unnecessary_label, gotoCK);
+  ADD_PATTERN6(simplify_end_of_conditional,
+      if_icmpeqCK, if_icmpneCK, if_icmpgeCK, if_icmpleCK, if_icmpgtCK, if_icmpltCK);
+  /* must come after simplify_end_of_conditional */
+  ADD_PATTERN6(remove_unnecessary_label_traversal,
+      if_icmpeqCK, if_icmpneCK, if_icmpgeCK, if_icmpleCK, if_icmpgtCK, if_icmpltCK);
+  ADD_PATTERN(remove_unnecessary_goto, gotoCK);
+  ADD_PATTERN(remove_useless_branch, ldc_intCK);
 }
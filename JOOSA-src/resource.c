@@ -119,8 +119,8 @@ void resSTATEMENT(STATEMENT *s)
              resSTATEMENT(s->val.ifelseS.elsepart);
              break;
         case whileK:
-             s->val.whileS.startlabel = nextlabel();
-             s->val.whileS.stoplabel = nextlabel();
+             s->val.whileS.looplabel = nextlabel();
+             s->val.whileS.testlabel = nextlabel();
              resEXP(s->val.whileS.condition);
              resSTATEMENT(s->val.whileS.body);
              break;
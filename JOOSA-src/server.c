@@ -0,0 +1,266 @@
+/*
+ * JOOS is Copyright (C) 1997 Laurie Hendren & Michael I. Schwartzbach
+ *
+ * Reproduction of all or part of this software is permitted for
+ * educational or research use on condition that this copyright notice is
+ * included in any copy. This software comes with no warranty of any
+ * kind. In no event will the authors be liable for any damages resulting from
+ * use of this software.
+ *
+ * email: hendren@cs.mcgill.ca, mis@brics.dk
+ */
+
+/* sockets and fork are POSIX, not ANSI, and peer credentials are not
+ * even POSIX
+ */
+#define _POSIX_C_SOURCE 200112L
+#define _GNU_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+#include "server.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+int openSocket(char *socketname, struct sockaddr_un *address)
+{ if (strlen(socketname)>=sizeof(address->sun_path)) {
+     fprintf(stderr,"socket name %s is too long\n",socketname);
+     return -1;
+  }
+  memset(address,0,sizeof(struct sockaddr_un));
+  address->sun_family = AF_UNIX;
+  strcpy(address->sun_path,socketname);
+  return socket(AF_UNIX,SOCK_STREAM,0);
+}
+
+int writeAll(int fd, char *buffer, int n)
+{ int k;
+  while (n>0) {
+    k = write(fd,buffer,n);
+    if (k<=0) return 0;
+    buffer += k;
+    n -= k;
+  }
+  return 1;
+}
+
+int readAll(int fd, char *buffer, int n)
+{ int k;
+  while (n>0) {
+    k = read(fd,buffer,n);
+    if (k<=0) return 0;
+    buffer += k;
+    n -= k;
+  }
+  return 1;
+}
+
+/* only the user running the server may use it, since a request picks the
+ * directory and the files the compile writes
+ */
+int trustedPeer(int fd)
+{
+#if defined(SO_PEERCRED)
+  struct ucred credentials;
+  socklen_t n;
+  n = sizeof(credentials);
+  if (getsockopt(fd,SOL_SOCKET,SO_PEERCRED,&credentials,&n)!=0) return 0;
+  return credentials.uid==geteuid();
+#else
+  uid_t uid;
+  gid_t gid;
+  if (getpeereid(fd,&uid,&gid)!=0) return 0;
+  return uid==geteuid();
+#endif
+}
+
+#define MAXREQUESTSTRINGS 65536
+
+/* reads a request into a buffer and splits it into argv, with argv[0]
+ * the client's directory.  Returns the number of strings, or -1.
+ */
+int readRequest(int fd, char **buffer, char ***argv)
+{ unsigned char header[4];
+  unsigned long count;
+  int size,used,k,argc,ended,i;
+  char *b,*bigger;
+  if (!readAll(fd,(char *)header,4)) return -1;
+  count = ((unsigned long)header[0]<<24)|((unsigned long)header[1]<<16)|
+          ((unsigned long)header[2]<<8)|header[3];
+  if (count<1 || count>MAXREQUESTSTRINGS) return -1;
+  argc = (int)count;
+  size = 4096;
+  used = 0;
+  ended = 0;
+  b = (char *)Malloc(size);
+  while (ended<argc) {
+    if (used==size) {
+       size *= 2;
+       bigger = (char *)realloc(b,size);
+       if (bigger==NULL) {
+          free(b);
+          return -1;
+       }
+       b = bigger;
+    }
+    k = read(fd,b+used,size-used);
+    if (k<=0) {
+       free(b);
+       return -1;
+    }
+    for (i=used; i<used+k; i++) if (b[i]=='\0') ended++;
+    used += k;
+  }
+  *argv = (char **)Malloc((argc+1)*sizeof(char *));
+  (*argv)[0] = b;
+  for (i=0, k=1; k<argc; i++) {
+      if (b[i]=='\0') (*argv)[k++] = b+i+1;
+  }
+  (*argv)[argc] = NULL;
+  *buffer = b;
+  return argc;
+}
+
+void serveRequest(int listener, int fd)
+{ char *buffer,**argv;
+  int argc,status;
+  char trailer[2];
+  pid_t child;
+  if (!trustedPeer(fd)) return;
+  argc = readRequest(fd,&buffer,&argv);
+  if (argc<1) return;
+  fflush(stdout);
+  fflush(stderr);
+  child = fork();
+  if (child==0) {
+     close(listener);
+     dup2(fd,1);
+     dup2(fd,2);
+     close(fd);
+     if (chdir(argv[0])!=0) {
+        printf("*** cannot change to directory %s\n",argv[0]);
+        exit(1);
+     }
+     /* argv[0] is skipped like a program name */
+     exit(compile(argc,argv));
+  }
+  status = 1;
+  if (child>0 && waitpid(child,&status,0)==child && WIFEXITED(status)) {
+     status = WEXITSTATUS(status);
+  } else {
+     status = 1;
+  }
+  trailer[0] = '\0';
+  trailer[1] = (char)status;
+  (void)writeAll(fd,trailer,2);
+  free(argv);
+  free(buffer);
+}
+
+int serveJOOS(char *socketname)
+{ struct sockaddr_un address;
+  int listener,fd,bound;
+  mode_t mask;
+  listener = openSocket(socketname,&address);
+  if (listener<0) {
+     perror(socketname);
+     return 1;
+  }
+  unlink(socketname);
+  /* the socket is only for the user who started the server */
+  mask = umask(077);
+  bound = bind(listener,(struct sockaddr *)&address,sizeof(address));
+  umask(mask);
+  if (bound!=0 || listen(listener,16)!=0) {
+     perror(socketname);
+     return 1;
+  }
+  /* a client that goes away must not take the server with it */
+  signal(SIGPIPE,SIG_IGN);
+  for (;;) {
+    fd = accept(listener,NULL,NULL);
+    if (fd<0) continue;
+    serveRequest(listener,fd);
+    close(fd);
+  }
+  return 0;
+}
+
+/* sends the request and copies the reply to stdout.  Returns the exit
+ * status of the compile, or -1 if there is no server to ask.
+ */
+int clientJOOS(char *socketname, int argc, char **argv)
+{ struct sockaddr_un address;
+  char directory[4096];
+  char buffer[4096];
+  unsigned char header[4];
+  char held[2];
+  int fd,i,k,n;
+  fd = openSocket(socketname,&address);
+  if (fd<0) return -1;
+  if (connect(fd,(struct sockaddr *)&address,sizeof(address))!=0 ||
+      getcwd(directory,sizeof(directory))==NULL) {
+     close(fd);
+     return -1;
+  }
+  /* the number of strings, then the strings */
+  header[0] = (unsigned char)((argc+1)>>24);
+  header[1] = (unsigned char)((argc+1)>>16);
+  header[2] = (unsigned char)((argc+1)>>8);
+  header[3] = (unsigned char)(argc+1);
+  if (!writeAll(fd,(char *)header,4) ||
+      !writeAll(fd,directory,strlen(directory)+1)) {
+     close(fd);
+     return -1;
+  }
+  for (i=0; i<argc; i++) {
+      if (!writeAll(fd,argv[i],strlen(argv[i])+1)) {
+         close(fd);
+         return -1;
+      }
+  }
+
+  /* the last two bytes are the trailer, so always hold two back */
+  n = 0;
+  while ((k = read(fd,buffer,sizeof(buffer)))>0) {
+    for (i=0; i<k; i++) {
+        if (n==2) {
+           putchar(held[0]);
+           held[0] = held[1];
+           n = 1;
+        }
+        held[n++] = buffer[i];
+    }
+  }
+  close(fd);
+  fflush(stdout);
+  if (n<2 || held[0]!='\0') {
+     fprintf(stderr,"*** compile server %s failed\n",socketname);
+     return 1;
+  }
+  return (unsigned char)held[1];
+}
+
+#else
+
+int serveJOOS(char *socketname)
+{ fprintf(stderr,"the compile server needs Unix sockets\n");
+  return 1;
+}
+
+int clientJOOS(char *socketname, int argc, char **argv)
+{ return -1;
+}
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ * JOOS is Copyright (C) 1997 Laurie Hendren & Michael I. Schwartzbach
+ *
+ * Reproduction of all or part of this software is permitted for
+ * educational or research use on condition that this copyright notice is
+ * included in any copy. This software comes with no warranty of any
+ * kind. In no event will the authors be liable for any damages resulting from
+ * use of this software.
+ *
+ * email: hendren@cs.mcgill.ca, mis@brics.dk
+ */
+
+/* A compile server keeps the extern classes it was started with, and the
+ * names they interned, in memory.  It listens on a Unix socket, and for
+ * every request forks a child that compiles in the client's directory,
+ * so each compile starts from the same state and may exit on errors.
+ *
+ * A request is the number of strings that follow as four bytes, most
+ * significant first, then the client's directory and its arguments, each
+ * ended by a NUL.  The reply is everything the compile printed, then a
+ * NUL and the exit status as one byte.
+ *
+ * The socket is created for its owner only, and connections from any
+ * other user are closed unanswered.
+ */
+
+int serveJOOS(char *socketname);
+int clientJOOS(char *socketname, int argc, char **argv);
+
+/* in main.c */
+int compile(int argc, char **argv);
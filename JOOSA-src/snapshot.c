@@ -0,0 +1,438 @@
+/*
+ * JOOS is Copyright (C) 1997 Laurie Hendren & Michael I. Schwartzbach
+ *
+ * Reproduction of all or part of this software is permitted for
+ * educational or research use on condition that this copyright notice is
+ * included in any copy. This software comes with no warranty of any
+ * kind. In no event will the authors be liable for any damages resulting from
+ * use of this software.
+ *
+ * email: hendren@cs.mcgill.ca, mis@brics.dk
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+#include "snapshot.h"
+
+/* the process id tells apart compiles writing the same snapshot */
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define WRITERID() ((long)getpid())
+#elif defined(_WIN32)
+#include <process.h>
+#define WRITERID() ((long)_getpid())
+#else
+#define WRITERID() 0L
+#endif
+
+#define SNAPORDER 0x01020304
+
+int isExternFile(char *name)
+{ int n;
+  n = strlen(name);
+  return n>5 && strcmp(name+n-5,".joos")==0;
+}
+
+/* FNV-1a over the name and the bytes of the file */
+unsigned hashExternFile(char *name, unsigned hash)
+{ FILE *f;
+  char *p;
+  int c;
+  if (hash==0) hash = 2166136261U;
+  for (p = name; *p; p++) hash = (hash ^ (unsigned char)*p) * 16777619U;
+  hash = (hash ^ 0xff) * 16777619U;
+  if ((f = fopen(name,"rb"))==NULL) {
+     return (hash ^ 0xfe) * 16777619U;
+  }
+  while ((c = getc(f))!=EOF) hash = (hash ^ (unsigned)c) * 16777619U;
+  fclose(f);
+  return hash;
+}
+
+
+/* reading */
+
+SNAPHEADER *snapheader;
+SNAPPROGRAM *snapprograms;
+SNAPCLASS *snapclasses;
+SNAPCONSTRUCTOR *snapconstructors;
+SNAPMETHOD *snapmethods;
+SNAPFORMAL *snapformals;
+SNAPTYPE *snaptypes;
+char *snapstrings;
+int snapok;
+
+/* points the arrays into a buffer that starts with snapheader */
+void snapLayout(char *buffer)
+{ char *p;
+  snapheader = (SNAPHEADER *)buffer;
+  p = buffer+sizeof(SNAPHEADER);
+  snapprograms = (SNAPPROGRAM *)p;
+  p += snapheader->programs*sizeof(SNAPPROGRAM);
+  snapclasses = (SNAPCLASS *)p;
+  p += snapheader->classes*sizeof(SNAPCLASS);
+  snapconstructors = (SNAPCONSTRUCTOR *)p;
+  p += snapheader->constructors*sizeof(SNAPCONSTRUCTOR);
+  snapmethods = (SNAPMETHOD *)p;
+  p += snapheader->methods*sizeof(SNAPMETHOD);
+  snapformals = (SNAPFORMAL *)p;
+  p += snapheader->formals*sizeof(SNAPFORMAL);
+  snaptypes = (SNAPTYPE *)p;
+  p += snapheader->types*sizeof(SNAPTYPE);
+  snapstrings = p;
+}
+
+long snapSize(SNAPHEADER *h)
+{ return sizeof(SNAPHEADER)+
+         h->programs*sizeof(SNAPPROGRAM)+
+         h->classes*sizeof(SNAPCLASS)+
+         h->constructors*sizeof(SNAPCONSTRUCTOR)+
+         h->methods*sizeof(SNAPMETHOD)+
+         h->formals*sizeof(SNAPFORMAL)+
+         h->types*sizeof(SNAPTYPE)+
+         h->strings;
+}
+
+char *snapName(int i)
+{ if (i<0) return NULL;
+  if (i>=snapheader->strings) {
+     snapok = 0;
+     return NULL;
+  }
+  return intern(snapstrings+i);
+}
+
+/* is the run of count records from first inside an array of size? */
+int snapRun(int first, int count, int size)
+{ if (first<0 || count<0 || first+count>size) snapok = 0;
+  return snapok;
+}
+
+TYPE *snapTYPE(int i)
+{ SNAPTYPE *t;
+  TYPE *type;
+  if (!snapRun(i,1,snapheader->types)) return NULL;
+  t = &snaptypes[i];
+  switch (t->kind) {
+    case intK:
+         type = makeTYPEint();
+         break;
+    case boolK:
+         type = makeTYPEbool();
+         break;
+    case charK:
+         type = makeTYPEchar();
+         break;
+    case voidK:
+         type = makeTYPEvoid();
+         break;
+    case refK:
+         type = makeTYPEref(snapName(t->name));
+         type->class = NULL;
+         break;
+    default:
+         snapok = 0;
+         return NULL;
+  }
+  type->lineno = t->lineno;
+  return type;
+}
+
+FORMAL *snapFORMALS(int first, int count)
+{ FORMAL *formals;
+  SNAPFORMAL *f;
+  int i;
+  formals = NULL;
+  if (!snapRun(first,count,snapheader->formals)) return NULL;
+  for (i=first+count-1; i>=first; i--) {
+      f = &snapformals[i];
+      formals = makeFORMAL(snapName(f->name),snapTYPE(f->type),formals);
+      formals->lineno = f->lineno;
+  }
+  return formals;
+}
+
+CONSTRUCTOR *snapCONSTRUCTORS(int first, int count)
+{ CONSTRUCTOR *constructors;
+  SNAPCONSTRUCTOR *c;
+  int i;
+  constructors = NULL;
+  if (!snapRun(first,count,snapheader->constructors)) return NULL;
+  for (i=first+count-1; i>=first; i--) {
+      c = &snapconstructors[i];
+      constructors = makeCONSTRUCTOR(snapName(c->name),
+                                     snapFORMALS(c->formals,c->formalcount),
+                                     NULL,constructors);
+      constructors->lineno = c->lineno;
+  }
+  return constructors;
+}
+
+METHOD *snapMETHODS(int first, int count)
+{ METHOD *methods;
+  SNAPMETHOD *m;
+  int i;
+  methods = NULL;
+  if (!snapRun(first,count,snapheader->methods)) return NULL;
+  for (i=first+count-1; i>=first; i--) {
+      m = &snapmethods[i];
+      methods = makeMETHOD(snapName(m->name),(ModifierKind)m->modifier,
+                           snapTYPE(m->returntype),
+                           snapFORMALS(m->formals,m->formalcount),
+                           NULL,methods);
+      methods->lineno = m->lineno;
+  }
+  return methods;
+}
+
+CLASSFILE *snapCLASSFILE(int first, int count)
+{ CLASSFILE *classfile;
+  SNAPCLASS *c;
+  CLASS *class;
+  int i;
+  classfile = NULL;
+  if (!snapRun(first,count,snapheader->classes)) return NULL;
+  for (i=first+count-1; i>=first; i--) {
+      c = &snapclasses[i];
+      class = makeCLASS(snapName(c->name),snapName(c->parentname),
+                        1,snapName(c->package),(ModifierKind)c->modifier,
+                        NULL,
+                        snapCONSTRUCTORS(c->constructors,c->constructorcount),
+                        snapMETHODS(c->methods,c->methodcount));
+      class->lineno = c->lineno;
+      classfile = makeCLASSFILE(class,classfile);
+  }
+  return classfile;
+}
+
+/* returns the extern programs in the order main would have made them, or
+ * NULL if there is no usable snapshot for hash
+ */
+PROGRAM *loadSnapshot(char *file, unsigned hash)
+{ FILE *f;
+  long size;
+  char *buffer;
+  PROGRAM *program;
+  int i;
+  if ((f = fopen(file,"rb"))==NULL) return NULL;
+  fseek(f,0,SEEK_END);
+  size = ftell(f);
+  rewind(f);
+  if (size<(long)sizeof(SNAPHEADER)) {
+     fclose(f);
+     return NULL;
+  }
+  buffer = (char *)Malloc(size);
+  if (fread(buffer,1,size,f)!=size) size = 0;
+  fclose(f);
+  snapheader = (SNAPHEADER *)buffer;
+  if (size==0 || memcmp(snapheader->magic,"JOOS",4)!=0 ||
+      snapheader->version!=SNAPVERSION || snapheader->order!=SNAPORDER ||
+      snapheader->hash!=hash || size!=snapSize(snapheader) ||
+      snapheader->strings<1 || buffer[size-1]!='\0') {
+     free(buffer);
+     return NULL;
+  }
+  snapLayout(buffer);
+
+  snapok = 1;
+  program = NULL;
+  for (i=snapheader->programs-1; i>=0; i--) {
+      program = makePROGRAM(snapName(snapprograms[i].name),
+                            snapCLASSFILE(snapprograms[i].classes,
+                                          snapprograms[i].classcount),
+                            program);
+  }
+  free(buffer);
+  if (!snapok) return NULL;
+  return program;
+}
+
+
+/* writing, in two passes.  The first only counts, the second fills in.
+ * Every list reserves its run of records before its elements reserve
+ * theirs, so the runs stay contiguous.
+ */
+
+SNAPHEADER snapsize;
+int snapfill;
+
+int saveString(char *s)
+{ int i;
+  if (s==NULL) return -1;
+  i = snapsize.strings;
+  snapsize.strings += strlen(s)+1;
+  if (snapfill) strcpy(snapstrings+i,s);
+  return i;
+}
+
+int saveTYPE(TYPE *t)
+{ int i,name;
+  i = snapsize.types++;
+  name = t->kind==refK ? saveString(t->name) : -1;
+  if (snapfill) {
+     snaptypes[i].lineno = t->lineno;
+     snaptypes[i].kind = t->kind;
+     snaptypes[i].name = name;
+  }
+  return i;
+}
+
+int saveFORMALS(FORMAL *f, int *count)
+{ FORMAL *l;
+  int first,i,name,type;
+  *count = 0;
+  for (l = f; l!=NULL; l = l->next) (*count)++;
+  first = snapsize.formals;
+  snapsize.formals += *count;
+  for (i = first; f!=NULL; f = f->next, i++) {
+      name = saveString(f->name);
+      type = saveTYPE(f->type);
+      if (snapfill) {
+         snapformals[i].lineno = f->lineno;
+         snapformals[i].name = name;
+         snapformals[i].type = type;
+      }
+  }
+  return first;
+}
+
+int saveCONSTRUCTORS(CONSTRUCTOR *c, int *count)
+{ CONSTRUCTOR *l;
+  int first,i,name,formals,formalcount;
+  *count = 0;
+  for (l = c; l!=NULL; l = l->next) (*count)++;
+  first = snapsize.constructors;
+  snapsize.constructors += *count;
+  for (i = first; c!=NULL; c = c->next, i++) {
+      name = saveString(c->name);
+      formals = saveFORMALS(c->formals,&formalcount);
+      if (snapfill) {
+         snapconstructors[i].lineno = c->lineno;
+         snapconstructors[i].name = name;
+         snapconstructors[i].formals = formals;
+         snapconstructors[i].formalcount = formalcount;
+      }
+  }
+  return first;
+}
+
+int saveMETHODS(METHOD *m, int *count)
+{ METHOD *l;
+  int first,i,name,returntype,formals,formalcount;
+  *count = 0;
+  for (l = m; l!=NULL; l = l->next) (*count)++;
+  first = snapsize.methods;
+  snapsize.methods += *count;
+  for (i = first; m!=NULL; m = m->next, i++) {
+      name = saveString(m->name);
+      returntype = saveTYPE(m->returntype);
+      formals = saveFORMALS(m->formals,&formalcount);
+      if (snapfill) {
+         snapmethods[i].lineno = m->lineno;
+         snapmethods[i].name = name;
+         snapmethods[i].modifier = m->modifier;
+         snapmethods[i].returntype = returntype;
+         snapmethods[i].formals = formals;
+         snapmethods[i].formalcount = formalcount;
+      }
+  }
+  return first;
+}
+
+int saveCLASSFILE(CLASSFILE *c, int *count)
+{ CLASSFILE *l;
+  SNAPCLASS s;
+  int first,i;
+  *count = 0;
+  for (l = c; l!=NULL; l = l->next) (*count)++;
+  first = snapsize.classes;
+  snapsize.classes += *count;
+  for (i = first; c!=NULL; c = c->next, i++) {
+      s.lineno = c->class->lineno;
+      s.name = saveString(c->class->name);
+      s.parentname = saveString(c->class->parentname);
+      s.package = saveString(c->class->package);
+      s.modifier = c->class->modifier;
+      s.constructors = saveCONSTRUCTORS(c->class->constructors,
+                                        &s.constructorcount);
+      s.methods = saveMETHODS(c->class->methods,&s.methodcount);
+      if (snapfill) snapclasses[i] = s;
+  }
+  return first;
+}
+
+void savePROGRAMS(PROGRAM *p)
+{ PROGRAM *l;
+  int first,i,name,classes,classcount;
+  first = snapsize.programs;
+  for (l = p; l!=NULL; l = l->next) {
+      if (isExternFile(l->name)) snapsize.programs++;
+  }
+  for (i = first; p!=NULL; p = p->next) {
+      if (!isExternFile(p->name)) continue;
+      name = saveString(p->name);
+      classes = saveCLASSFILE(p->classfile,&classcount);
+      if (snapfill) {
+         snapprograms[i].name = name;
+         snapprograms[i].classes = classes;
+         snapprograms[i].classcount = classcount;
+      }
+      i++;
+  }
+}
+
+/* the classes of the .joos files in p are written to file, unless one of
+ * them is not an extern class.  Failing to write is not an error, the
+ * next compile simply parses the .joos files again.
+ */
+void saveSnapshot(char *file, unsigned hash, PROGRAM *p)
+{ PROGRAM *l;
+  CLASSFILE *c;
+  char *buffer,*temp;
+  long size;
+  FILE *f;
+  int ok;
+  for (l = p; l!=NULL; l = l->next) {
+      if (!isExternFile(l->name)) continue;
+      for (c = l->classfile; c!=NULL; c = c->next) {
+          if (!c->class->external) return;
+      }
+  }
+  memset(&snapsize,0,sizeof(SNAPHEADER));
+  snapfill = 0;
+  savePROGRAMS(p);
+  size = snapSize(&snapsize);
+  buffer = (char *)Malloc(size);
+  memset(buffer,0,size);
+  memcpy(buffer,&snapsize,sizeof(SNAPHEADER));
+  snapLayout(buffer);
+  memcpy(snapheader->magic,"JOOS",4);
+  snapheader->version = SNAPVERSION;
+  snapheader->order = SNAPORDER;
+  snapheader->hash = hash;
+  memset(&snapsize,0,sizeof(SNAPHEADER));
+  snapfill = 1;
+  savePROGRAMS(p);
+
+  /* write a temporary file of our own and rename it, so that a compile
+   * running at the same time never reads half a snapshot, and two that
+   * write at once never write the same file
+   */
+  temp = (char *)Malloc(strlen(file)+32);
+  sprintf(temp,"%s.%ld.tmp",file,WRITERID());
+  ok = 0;
+  if ((f = fopen(temp,"wb"))!=NULL) {
+     ok = fwrite(buffer,1,size,f)==size;
+     ok = fclose(f)==0 && ok;
+  }
+  if (ok && rename(temp,file)!=0) {
+     remove(file);
+     ok = rename(temp,file)==0;
+  }
+  if (!ok) remove(temp);
+  free(temp);
+  free(buffer);
+}
@@ -0,0 +1,78 @@
+/*
+ * JOOS is Copyright (C) 1997 Laurie Hendren & Michael I. Schwartzbach
+ *
+ * Reproduction of all or part of this software is permitted for
+ * educational or research use on condition that this copyright notice is
+ * included in any copy. This software comes with no warranty of any
+ * kind. In no event will the authors be liable for any damages resulting from
+ * use of this software.
+ *
+ * email: hendren@cs.mcgill.ca, mis@brics.dk
+ */
+
+#include "tree.h"
+
+/* A snapshot holds the parsed classes of the .joos extern files, so they
+ * need not be scanned and parsed again by every compile.  It is a header
+ * followed by arrays of records that refer to each other and to a string
+ * area by index, never by pointer, so the file can be read or mapped in
+ * one piece.  The header carries a hash of the names and contents of the
+ * .joos files, and a snapshot whose hash differs is ignored.
+ */
+#define SNAPVERSION 1
+
+typedef struct SNAPHEADER {
+  char magic[4];
+  int version;
+  int order;          /* SNAPORDER as written, catches other byte orders */
+  unsigned hash;
+  int programs, classes, constructors, methods, formals, types;
+  int strings;        /* bytes in the string area */
+} SNAPHEADER;
+
+/* lists are runs of records in list order, and strings are offsets into
+ * the string area, -1 for NULL
+ */
+typedef struct SNAPPROGRAM {
+  int name;
+  int classes, classcount;
+} SNAPPROGRAM;
+
+typedef struct SNAPCLASS {
+  int lineno;
+  int name, parentname, package;
+  int modifier;
+  int constructors, constructorcount;
+  int methods, methodcount;
+} SNAPCLASS;
+
+typedef struct SNAPCONSTRUCTOR {
+  int lineno;
+  int name;
+  int formals, formalcount;
+} SNAPCONSTRUCTOR;
+
+typedef struct SNAPMETHOD {
+  int lineno;
+  int name;
+  int modifier;
+  int returntype;
+  int formals, formalcount;
+} SNAPMETHOD;
+
+typedef struct SNAPFORMAL {
+  int lineno;
+  int name;
+  int type;
+} SNAPFORMAL;
+
+typedef struct SNAPTYPE {
+  int lineno;
+  int kind;
+  int name;
+} SNAPTYPE;
+
+int isExternFile(char *name);
+unsigned hashExternFile(char *name, unsigned hash);
+PROGRAM *loadSnapshot(char *file, unsigned hash);
+void saveSnapshot(char *file, unsigned hash, PROGRAM *p);
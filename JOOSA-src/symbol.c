@@ -18,17 +18,27 @@
 
 extern char *currentfile;
 
-int Hash(char *str)
-{ unsigned int hash = 0;
-  while (*str) hash = (hash << 1) + *str++; 
-  return hash % HashSize;
+/* names are interned, so the address of a name identifies it */
+unsigned Hash(char *name)
+{ unsigned long h;
+  h = (unsigned long)name >> 3;
+  return (unsigned)(h * 2654435761UL) ^ (unsigned)(h >> 16);
+}
+
+SYMBOL **newScope(int size)
+{ SYMBOL **table;
+  int i;
+  table = (SYMBOL **)Allocate(SYMarena,size*sizeof(SYMBOL *));
+  for (i=0; i<size; i++) table[i] = NULL;
+  return table;
 }
 
 SymbolTable *initSymbolTable()
 { SymbolTable *t;
-  int i;
-  t = NEW(SymbolTable);
-  for (i=0; i < HashSize; i++) t->table[i] = NULL;
+  t = NEWIN(SYMarena,SymbolTable);
+  t->size = ScopeSize;
+  t->count = 0;
+  t->table = newScope(ScopeSize);
   t->next = NULL;
   return t;
 }
@@ -40,49 +50,141 @@ SymbolTable *scopeSymbolTable(SymbolTable *s)
   return t;
 }
 
+/* returns the slot of name in t, or the empty slot where it belongs */
+SYMBOL **findSymbol(SymbolTable *t, char *name)
+{ unsigned i;
+  SYMBOL **slot;
+  i = Hash(name) & (t->size-1);
+  for (slot = &t->table[i]; *slot!=NULL; slot = &t->table[i]) {
+      if ((*slot)->name==name) break;
+      i = (i+1) & (t->size-1);
+  }
+  return slot;
+}
+
+void growSymbolTable(SymbolTable *t)
+{ SYMBOL **old;
+  int oldsize,i;
+  old = t->table;
+  oldsize = t->size;
+  t->size = 2*oldsize;
+  t->table = newScope(t->size);
+  for (i=0; i<oldsize; i++) {
+      if (old[i]!=NULL) *findSymbol(t,old[i]->name) = old[i];
+  }
+}
+
 SYMBOL *putSymbol(SymbolTable *t, char *name, SymbolKind kind)
-{ int i = Hash(name);
+{ SYMBOL **slot;
   SYMBOL *s;
-  for (s = t->table[i]; s; s = s->next) {
-      if (strcmp(s->name,name)==0) return s;
+  slot = findSymbol(t,name);
+  if (*slot!=NULL) return *slot;
+  if (2*(t->count+1) > t->size) {
+     growSymbolTable(t);
+     slot = findSymbol(t,name);
   }
-  s = NEW(SYMBOL);
+  s = NEWIN(SYMarena,SYMBOL);
   s->name = name;
   s->kind = kind;
-  s->next = t->table[i];
-  t->table[i] = s;
+  *slot = s;
+  t->count++;
   return s;
 }
  
 SYMBOL *getSymbol(SymbolTable *t, char *name)
-{ int i = Hash(name);
-  SYMBOL *s;
-  for (s = t->table[i]; s; s = s->next) {
-      if (strcmp(s->name,name)==0) return s;
+{ SYMBOL *s;
+  for (; t!=NULL; t = t->next) {
+      if (t->count==0) continue;
+      s = *findSymbol(t,name);
+      if (s!=NULL) return s;
   }
-  if (t->next==NULL) return NULL;
-  return getSymbol(t->next,name);
+  return NULL;
 }
  
 int defSymbol(SymbolTable *t, char *name)
-{ int i = Hash(name);
-  SYMBOL *s;
-  for (s = t->table[i]; s; s = s->next) {
-      if (strcmp(s->name,name)==0) return 1;
-  }
-  return 0;
+{ return *findSymbol(t,name)!=NULL;
 }
 
 int subClass(CLASS *sub, CLASS *super)
 { if (sub==NULL) return 0;
-  if (strcmp(sub->name,super->name)==0) return 1;
+  if (sub->name==super->name) return 1;
   if (sub->parent==NULL) return 0;
   return subClass(sub->parent,super);
 }
 
+/* Member lookups are memoized per (class,name), misses included.  The
+ * class tables and parent links do not change once the interface phases
+ * are done, so until then the cache is left alone and afterwards it never
+ * needs invalidating.
+ */
+typedef struct MEMBER {
+   CLASS *start;
+   char *name;
+   SYMBOL *symbol;          /* NULL if name is not in the hierarchy */
+   CLASS *class;            /* the class that declares symbol */
+} MEMBER;
+
+MEMBER *members;
+int memberssize, memberscount;
+int hierarchyfixed;
+
+void initMembers()
+{ members = NULL;
+  memberssize = 0;
+  memberscount = 0;
+  hierarchyfixed = 0;
+}
+
+MEMBER *findMember(CLASS *start, char *name)
+{ unsigned i;
+  i = (Hash(name) ^ Hash((char *)start)*31) & (memberssize-1);
+  while (members[i].name!=NULL) {
+    if (members[i].start==start && members[i].name==name) break;
+    i = (i+1) & (memberssize-1);
+  }
+  return &members[i];
+}
+
+void growMembers()
+{ MEMBER *old;
+  int oldsize,i;
+  old = members;
+  oldsize = memberssize;
+  memberssize = oldsize==0 ? 256 : 2*oldsize;
+  members = (MEMBER *)Allocate(SYMarena,memberssize*sizeof(MEMBER));
+  for (i=0; i<memberssize; i++) members[i].name = NULL;
+  for (i=0; i<oldsize; i++) {
+      if (old[i].name!=NULL) *findMember(old[i].start,old[i].name) = old[i];
+  }
+}
+
+MEMBER *lookupMember(char *name, CLASS *start)
+{ MEMBER *m;
+  CLASS *c;
+  SYMBOL *s;
+  if (memberssize>0) {
+     m = findMember(start,name);
+     if (m->name!=NULL) return m;
+  }
+  if (2*(memberscount+1) > memberssize) growMembers();
+  m = findMember(start,name);
+  s = NULL;
+  for (c = start; c!=NULL; c = c->parent) {
+      s = getSymbol(c->localsym,name);
+      if (s!=NULL) break;
+  }
+  m->start = start;
+  m->name = name;
+  m->symbol = s;
+  m->class = c;
+  memberscount++;
+  return m;
+}
+
 SYMBOL *lookupHierarchy(char *name, CLASS *start)
 { SYMBOL *s;
   if (start==NULL) return NULL;
+  if (hierarchyfixed) return lookupMember(name,start)->symbol;
   s = getSymbol(start->localsym,name);
   if (s!=NULL) return s;
   if (start->parent==NULL) return NULL;
@@ -92,6 +194,7 @@ SYMBOL *lookupHierarchy(char *name, CLASS *start)
 CLASS *lookupHierarchyClass(char *name, CLASS *start)
 { SYMBOL *s;
   if (start==NULL) return NULL;
+  if (hierarchyfixed) return lookupMember(name,start)->class;
   s = getSymbol(start->localsym,name);
   if (s!=NULL) return start;
   if (start->parent==NULL) return NULL;
@@ -100,8 +203,10 @@ CLASS *lookupHierarchyClass(char *name, CLASS *start)
 
 void symPROGRAM(PROGRAM *p)
 { classlib = initSymbolTable();
+  initMembers();
   symInterfacePROGRAM(p,classlib);
   symInterfaceTypesPROGRAM(p,classlib);
+  hierarchyfixed = 1;
   symImplementationPROGRAM(p);
 }
 
@@ -146,7 +251,7 @@ void symInterfaceFIELD(FIELD *f, SymbolTable *sym)
 void symInterfaceCONSTRUCTOR(CONSTRUCTOR *c, char *classname, SymbolTable *sym)
 { if (c!=NULL) {
      symInterfaceCONSTRUCTOR(c->next,classname,sym);
-     if (!strcmp(classname,c->name)==0) {
+     if (classname!=c->name) {
         reportStrError("constructor name %s different from class name",
                          c->name,c->lineno);
      }
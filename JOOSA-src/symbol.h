@@ -12,10 +12,15 @@
 
 #include "tree.h"
 
-#define HashSize 317
+/* A scope is an open addressing table that starts small and doubles when
+ * half full, since most block scopes only hold a local or two.
+ */
+#define ScopeSize 4
 
 typedef struct SymbolTable {
-    SYMBOL *table[HashSize];
+    int size;                 /* always a power of two */
+    int count;
+    SYMBOL **table;
     struct SymbolTable *next;
 } SymbolTable;
 
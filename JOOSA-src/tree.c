@@ -11,6 +11,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "memory.h"
 #include "tree.h"
@@ -19,7 +20,7 @@ extern int lineno;
 
 PROGRAM *makePROGRAM(char *name, CLASSFILE *classfile, PROGRAM *next)
 { PROGRAM *p;
-  p = NEW(PROGRAM);
+  p = NEWIN(ASTarena,PROGRAM);
   p->name = name;
   p->classfile = classfile;
   p->next = next;
@@ -28,7 +29,7 @@ PROGRAM *makePROGRAM(char *name, CLASSFILE *classfile, PROGRAM *next)
 
 CLASSFILE *makeCLASSFILE(CLASS *class, CLASSFILE *next)
 { CLASSFILE *c;
-  c = NEW(CLASSFILE);
+  c = NEWIN(ASTarena,CLASSFILE);
   c->class = class;
   c->next = next;
   return c;
@@ -38,11 +39,11 @@ CLASS *makeCLASS(char *name, char *parentname,
                  int external, char *package, ModifierKind modifier,
                  FIELD *fields, CONSTRUCTOR *constructors, METHOD *methods)
 { CLASS *c;
-  c = NEW(CLASS);
+  c = NEWIN(ASTarena,CLASS);
   c->lineno = lineno;
   c->name = name;
   if (parentname==NULL && (strcmp(name,"Object")!=0)) {
-     c->parentname = "Object";
+     c->parentname = intern("Object");
   } else {
      c->parentname = parentname;
   }
@@ -57,7 +58,7 @@ CLASS *makeCLASS(char *name, char *parentname,
 
 FIELD *makeFIELD(char *name, TYPE *type, FIELD *next)
 { FIELD *f;
-  f = NEW(FIELD);
+  f = NEWIN(ASTarena,FIELD);
   f->lineno = lineno;
   f->name = name;
   f->type = type;
@@ -81,7 +82,7 @@ FIELD *appendFIELD(FIELD *f, FIELD *g)
 
 TYPE *makeTYPEint()
 { TYPE *t;
-  t = NEW(TYPE);
+  t = NEWIN(ASTarena,TYPE);
   t->lineno = lineno;
   t->kind = intK;
   return t;
@@ -89,7 +90,7 @@ TYPE *makeTYPEint()
 
 TYPE *makeTYPEbool()
 { TYPE *t;
-  t = NEW(TYPE);
+  t = NEWIN(ASTarena,TYPE);
   t->lineno = lineno;
   t->kind = boolK;
   return t;
@@ -97,7 +98,7 @@ TYPE *makeTYPEbool()
 
 TYPE *makeTYPEchar()
 { TYPE *t;
-  t = NEW(TYPE);
+  t = NEWIN(ASTarena,TYPE);
   t->lineno = lineno;
   t->kind = charK;
   return t;
@@ -105,7 +106,7 @@ TYPE *makeTYPEchar()
 
 TYPE *makeTYPEvoid()
 { TYPE *t;
-  t = NEW(TYPE);
+  t = NEWIN(ASTarena,TYPE);
   t->lineno = lineno;
   t->kind = voidK;
   return t;
@@ -113,7 +114,7 @@ TYPE *makeTYPEvoid()
 
 TYPE *makeTYPEref(char *name)
 { TYPE *t;
-  t = NEW(TYPE);
+  t = NEWIN(ASTarena,TYPE);
   t->lineno = lineno;
   t->kind = refK;
   t->name = name;
@@ -129,7 +130,7 @@ TYPE *makeTYPEextref(char *name, CLASS *c)
 
 ID *makeID(char *name, ID *next)
 { ID *i;
-  i = NEW(ID);
+  i = NEWIN(ASTarena,ID);
   i->name = name;
   i->next = next;
   return i;
@@ -137,7 +138,7 @@ ID *makeID(char *name, ID *next)
 
 CONSTRUCTOR *makeCONSTRUCTOR(char *name, FORMAL *formals, STATEMENT *statements, CONSTRUCTOR *next)
 { CONSTRUCTOR *c;
-  c = NEW(CONSTRUCTOR);
+  c = NEWIN(ASTarena,CONSTRUCTOR);
   c->lineno = lineno;
   c->name = name;
   c->formals = formals;
@@ -149,7 +150,7 @@ CONSTRUCTOR *makeCONSTRUCTOR(char *name, FORMAL *formals, STATEMENT *statements,
 METHOD *makeMETHOD(char *name, ModifierKind modifier, TYPE *returntype, 
                    FORMAL *formals, STATEMENT *statements, METHOD *next)
 { METHOD *m;
-  m = NEW(METHOD);
+  m = NEWIN(ASTarena,METHOD);
   m->lineno = lineno;
   m->name = name;
   m->modifier = modifier;
@@ -162,7 +163,7 @@ METHOD *makeMETHOD(char *name, ModifierKind modifier, TYPE *returntype,
 
 FORMAL *makeFORMAL(char *name, TYPE *type, FORMAL *next)
 { FORMAL *f;
-  f = NEW(FORMAL);
+  f = NEWIN(ASTarena,FORMAL);
   f->lineno = lineno;
   f->name = name;
   f->type = type;
@@ -172,7 +173,7 @@ FORMAL *makeFORMAL(char *name, TYPE *type, FORMAL *next)
 
 LOCAL *makeLOCAL(char *name, TYPE *type, LOCAL *next)
 { LOCAL *l;
-  l = NEW(LOCAL);
+  l = NEWIN(ASTarena,LOCAL);
   l->lineno = lineno;
   l->name = name;
   l->type = type;
@@ -187,7 +188,7 @@ LOCAL *makeLOCALlist(ID *names, TYPE *type)
 
 STATEMENT *makeSTATEMENTskip()
 { STATEMENT *s;
-  s = NEW(STATEMENT);
+  s = NEWIN(ASTarena,STATEMENT);
   s->lineno = lineno;
   s->kind = skipK;
   return s;
@@ -195,7 +196,7 @@ STATEMENT *makeSTATEMENTskip()
 
 STATEMENT *makeSTATEMENTexp(EXP *exp)
 { STATEMENT *s;
-  s = NEW(STATEMENT);
+  s = NEWIN(ASTarena,STATEMENT);
   s->lineno = lineno;
   s->kind = expK;
   s->val.expS = exp;
@@ -204,7 +205,7 @@ STATEMENT *makeSTATEMENTexp(EXP *exp)
 
 STATEMENT *makeSTATEMENTlocal(LOCAL *locals)
 { STATEMENT *s;
-  s = NEW(STATEMENT);
+  s = NEWIN(ASTarena,STATEMENT);
   s->lineno = lineno;
   s->kind = localK;
   s->val.localS = locals;
@@ -213,7 +214,7 @@ STATEMENT *makeSTATEMENTlocal(LOCAL *locals)
 
 STATEMENT *makeSTATEMENTreturn(EXP *exp)
 { STATEMENT *s;
-  s = NEW(STATEMENT);
+  s = NEWIN(ASTarena,STATEMENT);
   s->lineno = lineno;
   s->kind = returnK;
   s->val.returnS = exp;
@@ -224,7 +225,7 @@ STATEMENT *makeSTATEMENTsequence(STATEMENT *first, STATEMENT *second)
 { STATEMENT *s;
   if (first==NULL) return second;
   if (second==NULL) return first;
-  s = NEW(STATEMENT);
+  s = NEWIN(ASTarena,STATEMENT);
   s->lineno = lineno;
   s->kind = sequenceK;
   s->val.sequenceS.first = first;
@@ -234,7 +235,7 @@ STATEMENT *makeSTATEMENTsequence(STATEMENT *first, STATEMENT *second)
 
 STATEMENT *makeSTATEMENTif(EXP *condition, STATEMENT *body)
 { STATEMENT *s;
-  s = NEW(STATEMENT);
+  s = NEWIN(ASTarena,STATEMENT);
   s->lineno = lineno;
   s->kind = ifK;
   s->val.ifS.condition = condition;
@@ -246,7 +247,7 @@ STATEMENT *makeSTATEMENTifelse(EXP *condition,
                                STATEMENT *thenpart,
                                STATEMENT *elsepart)
 { STATEMENT *s;
-  s = NEW(STATEMENT);
+  s = NEWIN(ASTarena,STATEMENT);
   s->lineno = lineno;
   s->kind = ifelseK;
   s->val.ifelseS.condition = condition;
@@ -257,7 +258,7 @@ STATEMENT *makeSTATEMENTifelse(EXP *condition,
 
 STATEMENT *makeSTATEMENTwhile(EXP *condition, STATEMENT *body)
 { STATEMENT *s;
-  s = NEW(STATEMENT);
+  s = NEWIN(ASTarena,STATEMENT);
   s->lineno = lineno;
   s->kind = whileK;
   s->val.whileS.condition = condition;
@@ -267,7 +268,7 @@ STATEMENT *makeSTATEMENTwhile(EXP *condition, STATEMENT *body)
 
 STATEMENT *makeSTATEMENTblock(STATEMENT *body)
 {STATEMENT *s;
-  s = NEW(STATEMENT);
+  s = NEWIN(ASTarena,STATEMENT);
   s->lineno = lineno;
   s->kind = blockK;
   s->val.blockS.body = body;  
@@ -276,7 +277,7 @@ STATEMENT *makeSTATEMENTblock(STATEMENT *body)
 
 STATEMENT *makeSTATEMENTsupercons(ARGUMENT *args)
 {STATEMENT *s;
-  s = NEW(STATEMENT);
+  s = NEWIN(ASTarena,STATEMENT);
   s->lineno = lineno;
   s->kind = superconsK;
   s->val.superconsS.args = args;
@@ -285,7 +286,7 @@ STATEMENT *makeSTATEMENTsupercons(ARGUMENT *args)
 
 EXP *makeEXPid(char *name)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = idK;
@@ -295,7 +296,7 @@ EXP *makeEXPid(char *name)
 
 EXP *makeEXPassign(char *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = assignK;
@@ -306,7 +307,7 @@ EXP *makeEXPassign(char *left, EXP *right)
 
 EXP *makeEXPor(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = orK;
@@ -317,7 +318,7 @@ EXP *makeEXPor(EXP *left, EXP *right)
 
 EXP *makeEXPand(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = andK;
@@ -328,7 +329,7 @@ EXP *makeEXPand(EXP *left, EXP *right)
 
 EXP *makeEXPeq(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = eqK;
@@ -339,7 +340,7 @@ EXP *makeEXPeq(EXP *left, EXP *right)
 
 EXP *makeEXPlt(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = ltK;
@@ -350,7 +351,7 @@ EXP *makeEXPlt(EXP *left, EXP *right)
 
 EXP *makeEXPgt(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = gtK;
@@ -361,7 +362,7 @@ EXP *makeEXPgt(EXP *left, EXP *right)
 
 EXP *makeEXPleq(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = leqK;
@@ -372,7 +373,7 @@ EXP *makeEXPleq(EXP *left, EXP *right)
 
 EXP *makeEXPgeq(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = geqK;
@@ -383,7 +384,7 @@ EXP *makeEXPgeq(EXP *left, EXP *right)
 
 EXP *makeEXPneq(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = neqK;
@@ -394,7 +395,7 @@ EXP *makeEXPneq(EXP *left, EXP *right)
 
 EXP *makeEXPinstanceof(EXP *left, char *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = instanceofK;
@@ -405,7 +406,7 @@ EXP *makeEXPinstanceof(EXP *left, char *right)
 
 EXP *makeEXPplus(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = plusK;
@@ -416,7 +417,7 @@ EXP *makeEXPplus(EXP *left, EXP *right)
 
 EXP *makeEXPminus(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = minusK;
@@ -427,7 +428,7 @@ EXP *makeEXPminus(EXP *left, EXP *right)
 
 EXP *makeEXPtimes(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = timesK;
@@ -438,7 +439,7 @@ EXP *makeEXPtimes(EXP *left, EXP *right)
 
 EXP *makeEXPdiv(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = divK;
@@ -449,7 +450,7 @@ EXP *makeEXPdiv(EXP *left, EXP *right)
 
 EXP *makeEXPmod(EXP *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = modK;
@@ -460,7 +461,7 @@ EXP *makeEXPmod(EXP *left, EXP *right)
 
 EXP *makeEXPnot(EXP *not)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = notK;
@@ -470,7 +471,7 @@ EXP *makeEXPnot(EXP *not)
 
 EXP *makeEXPuminus(EXP *uminus)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = uminusK;
@@ -480,7 +481,7 @@ EXP *makeEXPuminus(EXP *uminus)
 
 EXP *makeEXPthis()
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = thisK;
@@ -489,7 +490,7 @@ EXP *makeEXPthis()
 
 EXP *makeEXPnew(char *name, ARGUMENT *args)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = newK;
@@ -500,7 +501,7 @@ EXP *makeEXPnew(char *name, ARGUMENT *args)
 
 EXP *makeEXPinvoke(RECEIVER *receiver, char *name, ARGUMENT *args)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = invokeK;
@@ -512,7 +513,7 @@ EXP *makeEXPinvoke(RECEIVER *receiver, char *name, ARGUMENT *args)
 
 EXP *makeEXPintconst(int intconst)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = intconstK;
@@ -522,7 +523,7 @@ EXP *makeEXPintconst(int intconst)
 
 EXP *makeEXPboolconst(int boolconst)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = boolconstK;
@@ -532,7 +533,7 @@ EXP *makeEXPboolconst(int boolconst)
 
 EXP *makeEXPcharconst(char charconst)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = charconstK;
@@ -542,7 +543,7 @@ EXP *makeEXPcharconst(char charconst)
 
 EXP *makeEXPstringconst(char *stringconst)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = stringconstK;
@@ -552,7 +553,7 @@ EXP *makeEXPstringconst(char *stringconst)
 
 EXP *makeEXPnull()
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = nullK;
@@ -561,7 +562,7 @@ EXP *makeEXPnull()
 
 EXP *makeEXPcast(char *left, EXP *right)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = castK;
@@ -572,7 +573,7 @@ EXP *makeEXPcast(char *left, EXP *right)
 
 EXP *makeEXPcharcast(EXP *charcast)
 { EXP *e;
-  e = NEW(EXP);
+  e = NEWIN(ASTarena,EXP);
   e->lineno = lineno;
   e->tostring = 0;
   e->kind = charcastK;
@@ -582,7 +583,7 @@ EXP *makeEXPcharcast(EXP *charcast)
 
 RECEIVER *makeRECEIVERobject(EXP *object)
 { RECEIVER *r;
-  r = NEW(RECEIVER);
+  r = NEWIN(ASTarena,RECEIVER);
   r->lineno = lineno;
   r->kind = objectK;
   r->objectR = object;
@@ -591,7 +592,7 @@ RECEIVER *makeRECEIVERobject(EXP *object)
 
 RECEIVER *makeRECEIVERsuper()
 { RECEIVER *r;
-  r = NEW(RECEIVER);
+  r = NEWIN(ASTarena,RECEIVER);
   r->lineno = lineno;
   r->kind = superK;
   return r;
@@ -599,35 +600,117 @@ RECEIVER *makeRECEIVERsuper()
 
 ARGUMENT *makeARGUMENT(EXP *exp, ARGUMENT *next)
 { ARGUMENT *a;
-  a = NEW(ARGUMENT);
+  a = NEWIN(ASTarena,ARGUMENT);
   a->exp = exp;
   a->next = next;
   return a;
 }
 
+/* The instructions of a method are kept in one array in the CODE arena,
+ * in order.  While code.c generates a method, each new CODE takes the next
+ * entry of a growable buffer and appendCODE keeps it there; closeCODE then
+ * packs the method into an array of exactly its size.  The next links from
+ * each entry to the one after it are what everybody walks, so next() and
+ * the patterns do not see the array.  A rewrite relinks entries, leaving the
+ * ones it drops behind as tombstones, and takes the CODE it adds from the
+ * arena; compactCODE packs the method again once the optimizer is done.
+ * Code generation is not parallel, so one buffer does for all methods.
+ */
+CODE *codebuffer;
+int codebuffersize, codebufferused;
+int codebuffering;
+
+CODE *newCODE()
+{ CODE *c;
+  if (codebuffering) {
+     if (codebufferused==codebuffersize) {
+        codebuffersize = codebuffersize==0 ? 1024 : 2*codebuffersize;
+        codebuffer = (CODE *)realloc(codebuffer,codebuffersize*sizeof(CODE));
+        if (codebuffer==NULL) {
+           fprintf(stderr,"Malloc(%d) failed.\n",
+                   (int)(codebuffersize*sizeof(CODE)));
+           abort();
+        }
+     }
+     c = &codebuffer[codebufferused];
+  } else {
+     c = NEWIN(CODEarena,CODE);
+  }
+  c->live = NULL;
+  c->block = -1;
+  c->prev = NULL;
+  c->queued = 0;
+  c->args = 0;
+  c->result = 0;
+  return c;
+}
+
+/* starts buffering the instructions of a method */
+void openCODE()
+{ codebuffering = 1;
+  codebufferused = 0;
+}
+
+/* keeps c, the CODE made last, as the next instruction of the method */
+void keepCODE(CODE *c)
+{ if (c==&codebuffer[codebufferused]) codebufferused++;
+}
+
+/* copies the n instructions of the list c into one array in the CODE
+ * arena and points the labels defined there at their copies
+ */
+CODE *packCODE(CODE *c, int n, LABEL *labels)
+{ CODE *a;
+  int i;
+  if (n==0) return NULL;
+  a = (CODE *)Allocate(CODEarena,n*sizeof(CODE));
+  for (i=0; i<n; i++, c=c->next) {
+      a[i] = *c;
+      a[i].next = i+1<n ? &a[i+1] : NULL;
+      if (a[i].kind==labelCK) labels[a[i].val.labelC].position = &a[i];
+  }
+  return a;
+}
+
+/* ends the method being buffered and returns its instructions */
+CODE *closeCODE(LABEL *labels)
+{ int i;
+  codebuffering = 0;
+  for (i=0; i<codebufferused; i++) {
+      codebuffer[i].next = i+1<codebufferused ? &codebuffer[i+1] : NULL;
+  }
+  return packCODE(codebuffer,codebufferused,labels);
+}
+
+/* returns the instructions of the list c, without tombstones in between */
+CODE *compactCODE(CODE *c, LABEL *labels)
+{ CODE *p;
+  int n;
+  n = 0;
+  for (p=c; p!=NULL; p=p->next) n++;
+  return packCODE(c,n,labels);
+}
+
 CODE *makeCODEnop(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = nopCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
 
 CODE *makeCODEi2c(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = i2cCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEnew(char *arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = newCK;
-  c->visited = 0;
   c->val.newC = arg;
   c->next = next;
   return c;
@@ -635,18 +718,16 @@ CODE *makeCODEnew(char *arg, CODE *next)
  
 CODE *makeCODEinstanceof(char *arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = instanceofCK;
-  c->visited = 0;
   c->val.instanceofC = arg;
   c->next = next;
   return c;
 }
 CODE *makeCODEcheckcast(char *arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = checkcastCK;
-  c->visited = 0;
   c->val.checkcastC = arg;
   c->next = next;
   return c;
@@ -654,63 +735,56 @@ CODE *makeCODEcheckcast(char *arg, CODE *next)
  
 CODE *makeCODEimul(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = imulCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEineg(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = inegCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEirem(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = iremCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEisub(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = isubCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
 
 CODE *makeCODEidiv(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = idivCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEiadd(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = iaddCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
 
 CODE *makeCODEiinc(int offset, int amount, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = iincCK;
-  c->visited = 0;
   c->val.iincC.offset = offset;
   c->val.iincC.amount = amount;
   c->next = next;
@@ -719,9 +793,8 @@ CODE *makeCODEiinc(int offset, int amount, CODE *next)
 
 CODE *makeCODElabel(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = labelCK;
-  c->visited = 0;
   c->val.labelC = label;
   c->next = next;
   return c;
@@ -729,9 +802,8 @@ CODE *makeCODElabel(int label, CODE *next)
  
 CODE *makeCODEgoto(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = gotoCK;
-  c->visited = 0;
   c->val.gotoC = label;
   c->next = next;
   return c;
@@ -739,9 +811,8 @@ CODE *makeCODEgoto(int label, CODE *next)
  
 CODE *makeCODEifeq(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = ifeqCK;
-  c->visited = 0;
   c->val.ifeqC = label;
   c->next = next;
   return c;
@@ -749,9 +820,8 @@ CODE *makeCODEifeq(int label, CODE *next)
  
 CODE *makeCODEifne(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = ifneCK;
-  c->visited = 0;
   c->val.ifneC = label;
   c->next = next;
   return c;
@@ -759,9 +829,8 @@ CODE *makeCODEifne(int label, CODE *next)
  
 CODE *makeCODEif_acmpeq(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = if_acmpeqCK;
-  c->visited = 0;
   c->val.if_acmpeqC = label;
   c->next = next;
   return c;
@@ -769,9 +838,8 @@ CODE *makeCODEif_acmpeq(int label, CODE *next)
  
 CODE *makeCODEif_acmpne(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = if_acmpneCK;
-  c->visited = 0;
   c->val.if_acmpneC = label;
   c->next = next;
   return c;
@@ -779,9 +847,8 @@ CODE *makeCODEif_acmpne(int label, CODE *next)
 
 CODE *makeCODEifnull(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = ifnullCK;
-  c->visited = 0;
   c->val.ifnullC = label;
   c->next = next;
   return c;
@@ -789,9 +856,8 @@ CODE *makeCODEifnull(int label, CODE *next)
 
 CODE *makeCODEifnonnull(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = ifnonnullCK;
-  c->visited = 0;
   c->val.ifnonnullC = label;
   c->next = next;
   return c;
@@ -799,9 +865,8 @@ CODE *makeCODEifnonnull(int label, CODE *next)
  
 CODE *makeCODEif_icmpeq(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = if_icmpeqCK;
-  c->visited = 0;
   c->val.if_icmpeqC = label;
   c->next = next;
   return c;
@@ -809,9 +874,8 @@ CODE *makeCODEif_icmpeq(int label, CODE *next)
  
 CODE *makeCODEif_icmpgt(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = if_icmpgtCK;
-  c->visited = 0;
   c->val.if_icmpgtC = label;
   c->next = next;
   return c;
@@ -819,9 +883,8 @@ CODE *makeCODEif_icmpgt(int label, CODE *next)
  
 CODE *makeCODEif_icmplt(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = if_icmpltCK;
-  c->visited = 0;
   c->val.if_icmpltC = label;
   c->next = next;
   return c;
@@ -829,9 +892,8 @@ CODE *makeCODEif_icmplt(int label, CODE *next)
  
 CODE *makeCODEif_icmple(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = if_icmpleCK;
-  c->visited = 0;
   c->val.if_icmpleC = label;
   c->next = next;
   return c;
@@ -839,9 +901,8 @@ CODE *makeCODEif_icmple(int label, CODE *next)
  
 CODE *makeCODEif_icmpge(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = if_icmpgeCK;
-  c->visited = 0;
   c->val.if_icmpgeC = label;
   c->next = next;
   return c;
@@ -849,9 +910,8 @@ CODE *makeCODEif_icmpge(int label, CODE *next)
  
 CODE *makeCODEif_icmpne(int label, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = if_icmpneCK;
-  c->visited = 0;
   c->val.if_icmpneC = label;
   c->next = next;
   return c;
@@ -859,36 +919,32 @@ CODE *makeCODEif_icmpne(int label, CODE *next)
  
 CODE *makeCODEireturn(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = ireturnCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEareturn(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = areturnCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEreturn(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = returnCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEaload(int arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = aloadCK;
-  c->visited = 0;
   c->val.aloadC = arg;
   c->next = next;
   return c;
@@ -896,9 +952,8 @@ CODE *makeCODEaload(int arg, CODE *next)
 
 CODE *makeCODEastore(int arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = astoreCK;
-  c->visited = 0;
   c->val.astoreC = arg;
   c->next = next;
   return c;
@@ -906,9 +961,8 @@ CODE *makeCODEastore(int arg, CODE *next)
  
 CODE *makeCODEiload(int arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = iloadCK;
-  c->visited = 0;
   c->val.iloadC = arg;
   c->next = next;
   return c;
@@ -916,9 +970,8 @@ CODE *makeCODEiload(int arg, CODE *next)
  
 CODE *makeCODEistore(int arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = istoreCK;
-  c->visited = 0;
   c->val.istoreC = arg;
   c->next = next;
   return c;
@@ -926,36 +979,32 @@ CODE *makeCODEistore(int arg, CODE *next)
  
 CODE *makeCODEdup(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = dupCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEpop(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = popCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEswap(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = swapCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEldc_int(int arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE); 
+  c = newCODE(); 
   c->kind = ldc_intCK; 
-  c->visited = 0;
   c->val.ldc_intC = arg; 
   c->next = next;
   return c;
@@ -963,9 +1012,8 @@ CODE *makeCODEldc_int(int arg, CODE *next)
  
 CODE *makeCODEldc_string(char *arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = ldc_stringCK;
-  c->visited = 0;
   c->val.ldc_stringC = arg;
   c->next = next;
   return c;
@@ -973,18 +1021,16 @@ CODE *makeCODEldc_string(char *arg, CODE *next)
  
 CODE *makeCODEaconst_null(CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = aconst_nullCK;
-  c->visited = 0;
   c->next = next;
   return c;
 }
  
 CODE *makeCODEgetfield(char *arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = getfieldCK;
-  c->visited = 0;
   c->val.getfieldC = arg;
   c->next = next;
   return c;
@@ -992,30 +1038,109 @@ CODE *makeCODEgetfield(char *arg, CODE *next)
  
 CODE *makeCODEputfield(char *arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = putfieldCK;
-  c->visited = 0;
   c->val.putfieldC = arg;
   c->next = next;
   return c;
 }
  
+/* counts the argument and result slots of the invoke c from its method
+ * descriptor sig, so that later phases never need to parse it again.
+ * Every invoke is sized here, whoever makes it.
+ */
+void sizeINVOKE(CODE *c, char *sig)
+{ int i;
+  c->args = 0;
+  for (i=0; sig[i]!='('; i++);
+  for (i++; sig[i]!=')'; i++) {
+      c->args++;
+      if (sig[i]=='L') {
+         while (sig[i]!=';') i++;
+      }
+  }
+  c->result = sig[i+1]!='V';
+}
+
+/* inc, affected and used, as stack_effect in optimize.c explains them, of
+ * each kind of instruction.  The invokes are worked out from the slot
+ * counts sizeINVOKE gave them instead.
+ */
+struct { int inc, affected, used; } effects[] = {
+  { 0, 0, 0},   /* nop */
+  { 0,-1,-1},   /* i2c */
+  { 1, 0, 0},   /* new */
+  { 0,-1,-1},   /* instanceof */
+  { 0, 0,-1},   /* checkcast */
+  {-1,-2,-2},   /* imul */
+  { 0,-1,-1},   /* ineg */
+  {-1,-2,-2},   /* irem */
+  {-1,-2,-2},   /* isub */
+  {-1,-2,-2},   /* idiv */
+  {-1,-2,-2},   /* iadd */
+  { 0, 0, 0},   /* iinc */
+  { 0, 0, 0},   /* label */
+  { 0, 0, 0},   /* goto */
+  {-1,-1,-1},   /* ifeq */
+  {-1,-1,-1},   /* ifne */
+  {-2,-2,-2},   /* if_acmpeq */
+  {-2,-2,-2},   /* if_acmpne */
+  {-1,-1,-1},   /* ifnull */
+  {-1,-1,-1},   /* ifnonnull */
+  {-2,-2,-2},   /* if_icmpeq */
+  {-2,-2,-2},   /* if_icmpgt */
+  {-2,-2,-2},   /* if_icmplt */
+  {-2,-2,-2},   /* if_icmple */
+  {-2,-2,-2},   /* if_icmpge */
+  {-2,-2,-2},   /* if_icmpne */
+  {-1,-1,-1},   /* ireturn */
+  {-1,-1,-1},   /* areturn */
+  { 0, 0, 0},   /* return */
+  { 1, 0, 0},   /* aload */
+  {-1,-1,-1},   /* astore */
+  { 1, 0, 0},   /* iload */
+  {-1,-1,-1},   /* istore */
+  { 1, 0,-1},   /* dup */
+  {-1,-1,-1},   /* pop */
+  { 0,-2,-2},   /* swap */
+  { 1, 0, 0},   /* ldc_int */
+  { 1, 0, 0},   /* ldc_string */
+  { 1, 0, 0},   /* aconst_null */
+  { 0,-1,-1},   /* getfield */
+  {-2,-2,-2},   /* putfield */
+  { 0, 0, 0},   /* invokevirtual */
+  { 0, 0, 0}    /* invokenonvirtual */
+};
+
+/* the stack effect of c, for the code generator and the optimizer alike */
+void effectCODE(CODE *c, int *inc, int *affected, int *used)
+{ if (c->kind==invokevirtualCK || c->kind==invokenonvirtualCK) {
+     /* the receiver and one for each formal, then the result if any */
+     *used = *affected = -1-c->args;
+     *inc = *used+c->result;
+     return;
+  }
+  *inc = effects[c->kind].inc;
+  *affected = effects[c->kind].affected;
+  *used = effects[c->kind].used;
+}
+
 CODE *makeCODEinvokevirtual(char *arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = invokevirtualCK;
-  c->visited = 0;
   c->val.invokevirtualC = arg;
+  sizeINVOKE(c,arg);
   c->next = next;
   return c;
 }
 
 CODE *makeCODEinvokenonvirtual(char *arg, CODE *next)
 { CODE *c;
-  c = NEW(CODE);
+  c = newCODE();
   c->kind = invokenonvirtualCK;
-  c->visited = 0;
   c->val.invokenonvirtualC = arg;
+  sizeINVOKE(c,arg);
   c->next = next;
   return c;
 }
@@ -27,7 +27,6 @@ typedef struct SYMBOL {
       struct FORMAL *formalS;
       struct LOCAL *localS;
     } val;
-    struct SYMBOL *next;
 } SYMBOL; 
 
 typedef struct PROGRAM {
@@ -116,6 +115,7 @@ typedef struct LOCAL {
   int lineno;
   char *name;
   struct TYPE *type;
+  int index; /* defasn */
   int offset; /* resource */
   struct LOCAL *next;
 } LOCAL;
@@ -139,7 +139,7 @@ typedef struct STATEMENT {
             int elselabel,stoplabel; /* resource */} ifelseS;
     struct {struct EXP *condition; 
             struct STATEMENT *body;
-            int startlabel,stoplabel; /* resource */} whileS;
+            int looplabel,testlabel; /* resource */} whileS;
     struct {struct STATEMENT *body;} blockS;
     struct {struct ARGUMENT *args;
             struct CONSTRUCTOR *constructor; /* type */} superconsS;
@@ -229,8 +229,14 @@ typedef struct LABEL {
    char *name;
    int sources;
    struct CODE *position;
+   struct LABELUSE *uses; /* optimize */
 } LABEL;
 
+typedef struct LABELUSE {
+   struct CODE *branch;
+   struct LABELUSE *next;
+} LABELUSE;
+
 typedef struct CODE {
    enum {nopCK,i2cCK,
          newCK,instanceofCK,checkcastCK,
@@ -243,7 +249,12 @@ typedef struct CODE {
          aloadCK,astoreCK,iloadCK,istoreCK,dupCK,popCK,swapCK,
          ldc_intCK,ldc_stringCK,aconst_nullCK,
          getfieldCK,putfieldCK,invokevirtualCK,invokenonvirtualCK} kind;
-   int visited; /* emit */
+   unsigned *live; /* optimize */
+   struct CODE *prev; /* optimize */
+   int block; /* optimize */
+   int queued; /* optimize */
+   int args; /* code */
+   int result; /* code */
    union {
      char *newC;
      char *instanceofC;
@@ -341,6 +352,11 @@ EXP *makeEXPcharcast(EXP *charcast);
 RECEIVER *makeRECEIVERobject(EXP *object);
 RECEIVER *makeRECEIVERsuper();
 ARGUMENT *makeARGUMENT(EXP *exp, ARGUMENT *next);
+void openCODE();
+void keepCODE(CODE *c);
+CODE *closeCODE(LABEL *labels);
+CODE *compactCODE(CODE *c, LABEL *labels);
+void effectCODE(CODE *c, int *inc, int *affected, int *used);
 CODE *makeCODEnop(CODE *next);
 CODE *makeCODEi2c(CODE *next);
 CODE *makeCODEnew(char *arg, CODE *next);
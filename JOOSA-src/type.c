@@ -23,7 +23,7 @@ TYPE *polynullTYPE, *intTYPE, *boolTYPE, *charTYPE, *stringTYPE;
 
 TYPE *classTYPE(CLASS *c)
 { TYPE *t;
-  t = NEW(TYPE);
+  t = NEWIN(ASTarena,TYPE);
   t->kind = refK;
   t->name = c->name;
   t->class = c;
@@ -32,29 +32,29 @@ TYPE *classTYPE(CLASS *c)
 
 void initTypes()
 { SYMBOL *s;
-  polynullTYPE = NEW(TYPE);
+  polynullTYPE = NEWIN(ASTarena,TYPE);
   polynullTYPE->kind = polynullK;
-  intTYPE = NEW(TYPE);
+  intTYPE = NEWIN(ASTarena,TYPE);
   intTYPE->kind = intK;
-  boolTYPE = NEW(TYPE);
+  boolTYPE = NEWIN(ASTarena,TYPE);
   boolTYPE->kind = boolK;
-  charTYPE = NEW(TYPE);
+  charTYPE = NEWIN(ASTarena,TYPE);
   charTYPE->kind = charK;
-  s = getSymbol(classlib,"String");
+  s = getSymbol(classlib,intern("String"));
   if (s==NULL) {
      reportGlobalError("class String not found");
      noErrors();
   }
-  stringTYPE = NEW(TYPE);
+  stringTYPE = NEWIN(ASTarena,TYPE);
   stringTYPE->kind = refK;
-  stringTYPE->name = "String";
+  stringTYPE->name = s->val.classS->name;
   stringTYPE->class = s->val.classS;
 }
 
 int equalTYPE(TYPE *s, TYPE *t)
 { if (s->kind!=t->kind) return 0;
   if (s->kind==refK) {
-     return strcmp(s->name,t->name)==0;
+     return s->name==t->name;
   }
   return 1;
 }
@@ -1,6 +1,7 @@
 #!/bin/bash
 
 make -C JOOSA-src clean
+rm -f JOOSexterns/externs.snap
 rm -f PeepholeBenchmarks/bench*/*.*dump
 
 for BENCH_DIR in PeepholeBenchmarks/*/; do